@@ -0,0 +1,358 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "lattice.h"
+#include "potts_instances.h"
+#include "thread_pool.h"
+#include "splitmix.h"
+#include "cli_options.h"
+#include "GSLpp/error.h"
+
+// Batch runner for scans over a grid of parameters. Usage:
+//   potts-batch key=value ...
+// usually with config=<file> holding one key=value per line, see
+// cli_options.h. Grids take a list of values, every combination of the grid
+// values is one job. The keys, with examples:
+//   dim=2,3                      lattice dimensions (2)
+//   q=2,3,4                      numbers of states (2)
+//   L=16,32                      linear lattice sizes (16)
+//   beta=0.9:1.1:0.05            (1)
+//   H=0                          (0)
+//   J=1;1,0.5                    sets of shell couplings, separated by ; (1)
+//   periodic=1                   (1)
+//   move=cluster                 metropolis, heat_bath, cluster, swendsen_wang (cluster)
+//   cluster_moves=1              (1)
+//   improved=0                   cluster estimators of m2 and m4 at H = 0 (0)
+//   thermalisation=1000          sweeps before measuring (1000)
+//   sweeps=10000                 sweeps while measuring (10000)
+//   measure_every=10             (10)
+//   seed=1                       (1)
+//   threads=0                    0 uses all hardware threads (0)
+//   output=results.dat           (results.dat)
+// Every (dim, q) pair of the grid must be one of the models of libpotts,
+// listed in potts_instances.h. Jobs run on a work stealing pool, one job per
+// thread, largest lattices first. Jobs with the same dim, L, periodicity and
+// number of J shells share one neighbour table. All results go to one file,
+// a line per job in the order of the grid.
+
+struct Batch_config_t{
+	std::vector<size_t> dims, qs, sizes;
+	std::vector<double> betas, Hs;
+	std::vector<std::vector<double>> Js;
+	bool periodic;
+	Sweep_options_t options;
+	size_t thermalisation, sweeps, measure_every;
+	uint64_t seed;
+	size_t threads;
+	std::string output;
+};
+
+struct Job_t{
+	size_t id, dim, q, L;
+	double beta, H;
+	std::vector<double> J;
+};
+
+// Averages over the measurements of one job, the energy error from 16 bins.
+// The Binder cumulant of the q - 1 component Potts order parameter is
+// 1 - (q - 1)/(q + 1) <m4>/<m2>^2, which is 0 in the disordered phase and
+// 2/(q + 1) in the ordered one (the Ising 1 - <m4>/(3 <m2>^2) for q = 2).
+struct Result_t{
+	size_t n_measurements;
+	double energy, energy_error, specific_heat, magnetization, m2, m4, susceptibility, binder;
+	double seconds;
+};
+
+static Batch_config_t read_config(const Options& options)
+{
+	Batch_config_t config;
+	config.dims = parse_sizes(option(options, "dim", "2"));
+	config.qs = parse_sizes(option(options, "q", "2"));
+	config.sizes = parse_sizes(option(options, "L", "16"));
+	config.betas = parse_numbers(option(options, "beta", "1"));
+	config.Hs = parse_numbers(option(options, "H", "0"));
+	std::istringstream sets(option(options, "J", "1"));
+	std::string set;
+	while(std::getline(sets, set, ';')){
+		config.Js.push_back(parse_numbers(set));
+	}
+	config.periodic = parse_size(option(options, "periodic", "1")) != 0;
+	config.options.move = parse_move(option(options, "move", "cluster"));
+	config.options.cluster_moves = parse_size(option(options, "cluster_moves", "1"));
+	config.options.improved_estimators = parse_size(option(options, "improved", "0")) != 0;
+	config.thermalisation = parse_size(option(options, "thermalisation", "1000"));
+	config.sweeps = parse_size(option(options, "sweeps", "10000"));
+	config.measure_every = parse_size(option(options, "measure_every", "10"));
+	config.seed = parse_u64(option(options, "seed", "1"));
+	config.threads = parse_size(option(options, "threads", "0"));
+	config.output = option(options, "output", "results.dat");
+	return config;
+}
+
+// Neighbour tables of one dimension, keyed by (L, periodic, number of
+// shells). The first job needing a table builds it from a throwaway crystal,
+// jobs asking for it meanwhile wait on the future. A table is dropped from
+// the cache once every job expecting it has taken it.
+template<size_t dim>
+class Geometry_cache_t{
+	private:
+		using Table = std::shared_ptr<const Neighbour_table_t<dim>>;
+		using Key = std::tuple<size_t, bool, size_t>;
+		struct Entry_t{
+			std::shared_future<Table> table;
+			size_t n_users = 0;
+		};
+
+		std::mutex lock_m;
+		std::map<Key, Entry_t> tables_m;
+
+		static Table build(const size_t L, const bool periodic, const std::vector<double>& J)
+		{
+			std::array<size_t, dim> size;
+			size.fill(L);
+			GSL::Matrix m(dim, dim);
+			for(size_t i = 0; i < dim; i++){
+				m[i][i] = static_cast<double>(L);
+			}
+			Potts_t<dim, 2> geometry(Lattice_t<dim>(m), size, periodic);
+			geometry.set_interaction_parameters(J);
+			return geometry.neighbour_table();
+		}
+
+	public:
+		void expect(const size_t L, const bool periodic, const std::vector<double>& J)
+		{
+			std::lock_guard<std::mutex> guard(lock_m);
+			tables_m[Key(L, periodic, J.size())].n_users++;
+		}
+
+		Table get(const size_t L, const bool periodic, const std::vector<double>& J)
+		{
+			std::promise<Table> promise;
+			std::shared_future<Table> table;
+			bool owner = false;
+			{
+				std::lock_guard<std::mutex> guard(lock_m);
+				auto it = tables_m.find(Key(L, periodic, J.size()));
+				if(it == tables_m.end()){
+					throw std::logic_error("Neighbour table requested by an unexpected job");
+				}
+				if(!it->second.table.valid()){
+					it->second.table = promise.get_future().share();
+					owner = true;
+				}
+				table = it->second.table;
+				if(--it->second.n_users == 0){
+					tables_m.erase(it);
+				}
+			}
+			if(owner){
+				try{
+					promise.set_value(build(L, periodic, J));
+				}catch(...){
+					promise.set_exception(std::current_exception());
+				}
+			}
+			return table.get();
+		}
+};
+
+template<size_t dim>
+Geometry_cache_t<dim>& geometry_cache()
+{
+	static Geometry_cache_t<dim> cache;
+	return cache;
+}
+
+template<size_t dim, size_t q>
+Result_t run_job(const Job_t& job, const Batch_config_t& config)
+{
+	const auto start = std::chrono::steady_clock::now();
+	std::array<size_t, dim> size;
+	size.fill(job.L);
+	Potts_t<dim, q> potts(size, Site_order_t<dim>(size), geometry_cache<dim>().get(job.L, config.periodic, job.J), splitmix64(config.seed + job.id));
+	potts.set_interaction_parameters(job.J);
+	potts.set_beta(job.beta);
+	potts.set_H(job.H);
+	potts.track_occupation();
+
+	Sweep_options_t options = config.options;
+	potts.sweep(config.thermalisation, options);
+
+	std::vector<double> energies;
+	double e2 = 0, m = 0, m2 = 0, m4 = 0;
+	options.measure_every = config.measure_every;
+	options.measure = [&](const Observables_t& obs){
+		energies.push_back(obs.energy);
+		e2 += obs.energy*obs.energy;
+		m += obs.magnetization;
+		m2 += obs.m2;
+		m4 += obs.m4;
+	};
+	potts.sweep(config.sweeps, options);
+
+	Result_t res{energies.size(), 0, 0, 0, 0, 0, 0, 0, 0, 0};
+	if(!energies.empty()){
+		const double n = static_cast<double>(energies.size());
+		const double N = static_cast<double>(potts.field().size());
+		for(const auto e : energies){
+			res.energy += e/n;
+		}
+		const size_t n_bins = std::min<size_t>(16, energies.size());
+		if(n_bins > 1){
+			const size_t bin = energies.size()/n_bins;
+			double var = 0;
+			for(size_t b = 0; b < n_bins; b++){
+				double mean = 0;
+				for(size_t i = b*bin; i < (b + 1)*bin; i++){
+					mean += energies[i]/static_cast<double>(bin);
+				}
+				var += (mean - res.energy)*(mean - res.energy);
+			}
+			res.energy_error = std::sqrt(var/static_cast<double>(n_bins*(n_bins - 1)));
+		}
+		res.specific_heat = job.beta*job.beta*N*(e2/n - res.energy*res.energy);
+		res.magnetization = m/n;
+		res.m2 = m2/n;
+		res.m4 = m4/n;
+		res.susceptibility = job.beta*N*res.m2;
+		res.binder = res.m2 > 0 ? 1 - static_cast<double>(q - 1)/static_cast<double>(q + 1)*res.m4/(res.m2*res.m2) : 0;
+	}
+	res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return res;
+}
+
+using Runner = Result_t (*)(const Job_t&, const Batch_config_t&);
+
+// Job runner of a model in libpotts, nullptr if there is none
+static Runner runner(const size_t dim, const size_t q)
+{
+#define POTTS_RUNNER(d, n) \
+	if(dim == d && q == n){ \
+		return &run_job<d, n>; \
+	}
+	POTTS_INSTANCES(POTTS_RUNNER)
+#undef POTTS_RUNNER
+	return nullptr;
+}
+
+static void expect_geometry(const Job_t& job, const bool periodic)
+{
+#define POTTS_EXPECT(d) \
+	if(job.dim == d){ \
+		geometry_cache<d>().expect(job.L, periodic, job.J); \
+	}
+	POTTS_DIMS(POTTS_EXPECT)
+#undef POTTS_EXPECT
+}
+
+static std::vector<Job_t> make_jobs(const Batch_config_t& config)
+{
+	std::vector<Job_t> jobs;
+	for(const auto dim : config.dims){
+		for(const auto q : config.qs){
+			if(!runner(dim, q)){
+				throw std::invalid_argument("libpotts has no model for dim = " + std::to_string(dim) + ", q = " + std::to_string(q));
+			}
+			for(const auto L : config.sizes){
+				if(L == 0){
+					throw std::invalid_argument("Lattice sizes must be positive");
+				}
+				for(const auto& J : config.Js){
+					for(const auto H : config.Hs){
+						for(const auto beta : config.betas){
+							jobs.push_back(Job_t{jobs.size(), dim, q, L, beta, H, J});
+						}
+					}
+				}
+			}
+		}
+	}
+	return jobs;
+}
+
+static double n_sites(const Job_t& job)
+{
+	return std::pow(static_cast<double>(job.L), static_cast<double>(job.dim));
+}
+
+int main(int argc, char* argv[])
+{
+	GSL::Error_handler e_handler;
+	e_handler.off();
+
+	if(argc < 2){
+		std::cerr << "Usage: " << argv[0] << " config=<file> key=value ..., see batch.cpp for the keys\n";
+		return 1;
+	}
+	try{
+		const Batch_config_t config = read_config(read_options(argc, argv, {"config", "dim", "q", "L", "beta", "H", "J", "periodic", "move",
+			"cluster_moves", "improved", "thermalisation", "sweeps", "measure_every", "seed", "threads", "output"}));
+		const std::vector<Job_t> jobs = make_jobs(config);
+		std::vector<Result_t> results(jobs.size());
+
+		// Largest lattices first, ties in grid order
+		std::vector<size_t> order(jobs.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b){return n_sites(jobs[a]) > n_sites(jobs[b]);});
+
+		std::vector<std::function<void()>> tasks;
+		std::mutex print_lock;
+		size_t n_done = 0;
+		for(const auto j : order){
+			expect_geometry(jobs[j], config.periodic);
+			tasks.push_back([&, j]{
+#ifdef _OPENMP
+				// One job per thread, the parallel loops inside a job run serially
+				omp_set_num_threads(1);
+#endif
+				const Job_t& job = jobs[j];
+				results[j] = runner(job.dim, job.q)(job, config);
+				std::lock_guard<std::mutex> guard(print_lock);
+				std::cout << "Job " << ++n_done << "/" << jobs.size() << ": dim = " << job.dim << ", q = " << job.q << ", L = " << job.L;
+				std::cout << ", beta = " << job.beta << ", H = " << job.H << " (" << results[j].seconds << " s)\n";
+			});
+		}
+		Work_stealing_pool_t pool(config.threads);
+		std::cout << "Running " << jobs.size() << " jobs on " << pool.n_threads() << " threads\n";
+		pool.run(std::move(tasks));
+
+		std::ofstream out(config.output);
+		if(!out){
+			throw std::runtime_error("Cannot open " + config.output);
+		}
+		out << "# job dim q L beta H J n_measurements energy energy_error specific_heat magnetization m2 m4 susceptibility binder seconds\n";
+		out << std::setprecision(10);
+		for(size_t j = 0; j < jobs.size(); j++){
+			const Job_t& job = jobs[j];
+			const Result_t& res = results[j];
+			out << job.id << " " << job.dim << " " << job.q << " " << job.L << " " << job.beta << " " << job.H << " ";
+			for(size_t k = 0; k < job.J.size(); k++){
+				out << (k > 0 ? "," : "") << job.J[k];
+			}
+			out << " " << res.n_measurements << " " << res.energy << " " << res.energy_error << " " << res.specific_heat;
+			out << " " << res.magnetization << " " << res.m2 << " " << res.m4 << " " << res.susceptibility << " " << res.binder << " " << res.seconds << "\n";
+		}
+		std::cout << "Results written to " << config.output << "\n";
+	}catch(const std::exception& e){
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include "lattice.h"
+#include "potts.h"
+#include "memory.h"
+#include "GSLpp/error.h"
+
+template<size_t dim, size_t q>
+void bench(const size_t L, const Memory_policy_t& policy, const std::string& name)
+{
+	set_memory_policy(policy);
+	std::array<size_t, dim> size;
+	size.fill(L);
+	GSL::Matrix m(dim, dim);
+	for(size_t i = 0; i < dim; i++){
+		m[i][i] = static_cast<double>(L);
+	}
+	Lattice_t<dim> lat(m);
+	auto start = std::chrono::steady_clock::now();
+	Potts_t<dim, q> potts(lat, size, true, Site_ordering::Morton, 4);
+	potts.set_interaction_parameters({1.0});
+	auto stop = std::chrono::steady_clock::now();
+	const double setup = std::chrono::duration<double>(stop - start).count();
+	const size_t n_sites = potts.field().size();
+
+	// Parallel passes over all sites in a static schedule, as in the first touch
+	const size_t n_repeats = 10;
+	double energy = 0;
+	start = std::chrono::steady_clock::now();
+	for(size_t it = 0; it < n_repeats; it++){
+		energy += potts.total_energy();
+	}
+	stop = std::chrono::steady_clock::now();
+	const double ns_energy = std::chrono::duration<double, std::nano>(stop - start).count()/static_cast<double>(n_repeats*n_sites);
+
+	double delta = 0;
+	start = std::chrono::steady_clock::now();
+	for(size_t it = 0; it < n_repeats; it++){
+		#pragma omp parallel for reduction(+:delta) schedule(static)
+		for(size_t i = 0; i < n_sites; i++){
+			delta += potts.delta_energy(i, static_cast<typename Potts_t<dim, q>::spin_type>((potts.field().get(i) + 1) % q));
+		}
+	}
+	stop = std::chrono::steady_clock::now();
+	const double ns_delta = std::chrono::duration<double, std::nano>(stop - start).count()/static_cast<double>(n_repeats*n_sites);
+
+	std::cout << std::setw(28) << name;
+	std::cout << std::setw(10) << std::setprecision(3) << setup << " s";
+	std::cout << std::setw(12) << ns_energy << " ns/site";
+	std::cout << std::setw(12) << ns_delta << " ns/site";
+	std::cout << "   (E = " << energy/static_cast<double>(n_repeats) << ", dE = " << delta/static_cast<double>(n_repeats) << ")\n";
+}
+
+int main(int argc, char* argv[])
+{
+	GSL::Error_handler e_handler;
+	e_handler.off();
+
+	// Usage: bench-numa [L] [none|compact|spread]. Setting up the crystal
+	// needs far more memory than the tables themselves, so the default is small
+	size_t L = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+	std::string pin = argc > 2 ? argv[2] : "spread";
+	const Thread_pinning pinning = pin == "compact" ? Thread_pinning::Compact : (pin == "none" ? Thread_pinning::None : Thread_pinning::Spread);
+	if(!pin_threads(pinning)){
+		std::cout << "Could not pin threads\n";
+	}
+	std::cout << "NUMA nodes: " << memory_detail::n_numa_nodes() << ", pinning: " << pin << "\n";
+	std::cout << std::setw(28) << "placement" << std::setw(12) << "setup" << std::setw(20) << "total_energy" << std::setw(20) << "delta_energy" << "\n";
+
+	Memory_policy_t policy;
+	bench<3, 4>(L, policy, "serial first touch");
+	policy.parallel_first_touch = true;
+	bench<3, 4>(L, policy, "parallel first touch");
+	policy.pages = Page_size::Transparent_huge;
+	bench<3, 4>(L, policy, "parallel + THP");
+	policy.pages = Page_size::Explicit_huge;
+	bench<3, 4>(L, policy, "parallel + hugetlb");
+	policy.pages = Page_size::Transparent_huge;
+	policy.placement = Placement::Interleaved;
+	bench<3, 4>(L, policy, "interleaved + THP");
+	return 0;
+}
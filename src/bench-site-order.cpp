@@ -0,0 +1,88 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include "lattice.h"
+#include "potts.h"
+#include "GSLpp/error.h"
+
+// Fraction of nearest neighbours stored within window sites of each site
+template<size_t dim, size_t q>
+double near_neighbour_fraction(const Potts_t<dim, q>& potts, const size_t window = 64)
+{
+	const auto& nn = potts.neighbours();
+	size_t near = 0, count = 0;
+	for(size_t s = 0; s < nn.n_sites(); s++){
+		for(auto n = nn.begin(s, 0); n != nn.end(s, 0); n++){
+			near += (*n > s ? *n - s : s - *n) < window;
+			count++;
+		}
+	}
+	return static_cast<double>(near)/static_cast<double>(count);
+}
+
+template<size_t dim, size_t q>
+void bench(const size_t L, const Site_ordering ordering, const std::string& name, const size_t block = 1)
+{
+	std::array<size_t, dim> size;
+	size.fill(L);
+	GSL::Matrix m(dim, dim);
+	for(size_t i = 0; i < dim; i++){
+		m[i][i] = static_cast<double>(L);
+	}
+	Lattice_t<dim> lat(m);
+	Potts_t<dim, q> potts(lat, size, true, ordering, block);
+	potts.set_interaction_parameters({1.0});
+	potts.set_beta(0.5);
+
+	const size_t n_repeats = 10;
+	double energy = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(size_t it = 0; it < n_repeats; it++){
+		energy += potts.total_energy();
+	}
+	auto stop = std::chrono::steady_clock::now();
+	double ns_per_site = std::chrono::duration<double, std::nano>(stop - start).count()/static_cast<double>(n_repeats*potts.field().size());
+
+	Sweep_options_t options;
+	options.order = Visit_order::Sequential;
+	start = std::chrono::steady_clock::now();
+	potts.sweep(n_repeats, options);
+	stop = std::chrono::steady_clock::now();
+	double ns_per_update = std::chrono::duration<double, std::nano>(stop - start).count()/static_cast<double>(n_repeats*potts.field().size());
+
+	std::cout << std::setw(4) << dim << "D " << std::setw(5) << L << " " << std::setw(10) << name;
+	std::cout << std::setw(6) << block;
+	std::cout << std::setw(14) << potts.neighbours().bytes()/1024 << " kB";
+	std::cout << std::setw(16) << near_neighbour_fraction(potts);
+	std::cout << std::setw(12) << ns_per_site << " ns/site";
+	std::cout << std::setw(12) << ns_per_update << " ns/update";
+	std::cout << "   (E = " << energy/static_cast<double>(n_repeats) << ")\n";
+}
+
+template<size_t dim, size_t q>
+void bench_all(const size_t L)
+{
+	bench<dim, q>(L, Site_ordering::Row_major, "row major");
+	bench<dim, q>(L, Site_ordering::Morton, "morton");
+	bench<dim, q>(L, Site_ordering::Morton, "morton", 4);
+	bench<dim, q>(L, Site_ordering::Hilbert, "hilbert");
+	bench<dim, q>(L, Site_ordering::Hilbert, "hilbert", 4);
+}
+
+int main(int argc, char* argv[])
+{
+	GSL::Error_handler e_handler;
+	e_handler.off();
+
+	// Default sizes give neighbour tables well beyond a typical L2 cache
+	size_t L3 = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+	size_t L4 = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 24;
+
+	std::cout << " dim     L   ordering block   neighbour table   near nn fraction   energy kernel      sequential sweep\n";
+	bench_all<3, 3>(L3);
+	bench_all<4, 3>(L4);
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+#ifndef BOND_COUPLINGS_H
+#define BOND_COUPLINGS_H
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+#include "neighbour_table.h"
+#include "site_order.h"
+#include "memory.h"
+#include "splitmix.h"
+
+enum class Coupling_distribution{Constant, Gaussian, Bimodal, Uniform};
+
+// Distribution of the couplings in one neighbour shell. Bimodal couplings are
+// mean +- width, uniform ones are drawn from [mean - width, mean + width].
+// Each bond is removed (J = 0) with probability dilution.
+struct Disorder_t{
+	Coupling_distribution distribution = Coupling_distribution::Constant;
+	double mean = 1;
+	double width = 0;
+	double dilution = 0;
+};
+
+// One coupling per entry of a Neighbour_table_t, stored in the same order as
+// the neighbour indices so that kernels can walk both arrays in lockstep.
+// A bond's coupling is a hash of the seed, the shell and the row major indices
+// of its two sites, so J_ij = J_ji, and a realisation does not depend on the
+// site ordering. Integral T (e.g. int8_t) rounds the drawn couplings.
+template<class T = float>
+class Bond_couplings_t{
+	private:
+		size_t n_shells_m;
+		uint64_t seed_m;
+		Lattice_vector<T> J_m;
+
+		// Uniform number in (0, 1) from a 64 bit hash
+		static double to_unit(const uint64_t h)
+		{
+			return (static_cast<double>(h >> 11) + 0.5)/9007199254740992.;
+		}
+
+		double draw(const Disorder_t& d, const uint64_t key) const
+		{
+			const uint64_t h = splitmix64(seed_m ^ splitmix64(key));
+			if(d.dilution > 0 && to_unit(splitmix64(h ^ 0xd1b54a32d192ed03ULL)) < d.dilution){
+				return 0;
+			}
+			const double u = to_unit(h);
+			switch(d.distribution){
+				case Coupling_distribution::Gaussian:
+					return d.mean + d.width*std::sqrt(-2*std::log(u))*std::cos(2*M_PI*to_unit(splitmix64(h)));
+				case Coupling_distribution::Bimodal:
+					return u < 0.5 ? d.mean - d.width : d.mean + d.width;
+				case Coupling_distribution::Uniform:
+					return d.mean + d.width*(2*u - 1);
+				default:
+					return d.mean;
+			}
+		}
+
+		static T convert(const double J, std::true_type)
+		{
+			return static_cast<T>(std::lround(J));
+		}
+
+		static T convert(const double J, std::false_type)
+		{
+			return static_cast<T>(J);
+		}
+
+	public:
+		Bond_couplings_t() : n_shells_m(0), seed_m(0), J_m() {}
+
+		// Draw couplings for the first disorder.size() shells of the table
+		template<size_t dim>
+		Bond_couplings_t(const Neighbour_table_t<dim>& nn, const Site_order_t<dim>& order, const std::vector<Disorder_t>& disorder, const uint64_t seed)
+		 : n_shells_m(disorder.size()), seed_m(seed), J_m(nn.n_entries(), 0)
+		{
+			if(n_shells_m > nn.n_shells()){
+				throw std::invalid_argument("More disorder shells than neighbour shells");
+			}
+			const uint64_t n_sites = nn.n_sites();
+			for(size_t s = 0; s < nn.n_sites(); s++){
+				const uint64_t i = order.row_major_index(s);
+				for(size_t shell = 0; shell < n_shells_m; shell++){
+					size_t k = nn.offset(s, shell);
+					for(auto n = nn.begin(s, shell); n != nn.end(s, shell); n++, k++){
+						const uint64_t j = order.row_major_index(*n);
+						const uint64_t pair = i < j ? i*n_sites + j : j*n_sites + i;
+						J_m[k] = convert(draw(disorder[shell], pair*n_shells_m + shell), std::is_integral<T>());
+					}
+				}
+			}
+		}
+
+		size_t n_shells() const {return n_shells_m;}
+		size_t size() const {return J_m.size();}
+		size_t bytes() const {return J_m.size()*sizeof(T);}
+		uint64_t seed() const {return seed_m;}
+
+		// Coupling of the neighbour at position k of the neighbour table
+		const T* data() const {return J_m.data();}
+		T operator[](const size_t k) const {return J_m[k];}
+};
+
+// Calls f(neighbour, J) for every neighbour interacting with the site at
+// (storage) index. With bonds the couplings are read alongside the neighbour
+// indices, otherwise shell k couples with J[k].
+template<size_t dim, class T, class F>
+void for_each_coupled_neighbour(const Neighbour_table_t<dim>& nn, const Bond_couplings_t<T>* bonds, const std::vector<double>& J, const size_t index, F f)
+{
+	if(bonds){
+		const T* Jb = bonds->data();
+		for(size_t shell = 0; shell < bonds->n_shells(); shell++){
+			size_t k = nn.offset(index, shell);
+			for(auto n = nn.begin(index, shell); n != nn.end(index, shell); n++, k++){
+				f(static_cast<size_t>(*n), static_cast<double>(Jb[k]));
+			}
+		}
+	}else{
+		const size_t n_shells = std::min(J.size(), nn.n_shells());
+		for(size_t shell = 0; shell < n_shells; shell++){
+			const double J_shell = J[shell];
+			for(auto n = nn.begin(index, shell); n != nn.end(index, shell); n++){
+				f(static_cast<size_t>(*n), J_shell);
+			}
+		}
+	}
+}
+
+#endif // BOND_COUPLINGS_H
@@ -0,0 +1,305 @@
+#ifndef CELLULAR_POTTS_H
+#define CELLULAR_POTTS_H
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include "potts.h"
+
+// Volume and surface constraints of one cell type, a negative target switches
+// the constraint off
+struct Cell_type_t{
+	double target_volume = -1;
+	double lambda_volume = 0;
+	double target_surface = -1;
+	double lambda_surface = 0;
+};
+
+// Cellular Potts model (Graner and Glazier, PRL 69, 2013 (1992)) on the
+// lattice of a Potts_t. Spin values are cell ids, cell 0 is the medium. The
+// energy is
+//   sum_<ij> J(type(s_i), type(s_j)) (1 - delta(s_i, s_j))
+//   + sum_cells lambda_V (V - V_target)^2 + lambda_S (S - S_target)^2,
+// with the adhesion summed over the first n_adhesion_shells neighbour shells
+// and the surface S counted over nearest neighbour pairs. A copy attempt
+// picks a site on a cell boundary and tries to copy the id of a random
+// nearest neighbour into it. Volumes, surfaces and the number of unlike
+// nearest neighbours of every site are updated incrementally, so an attempt
+// costs O(z). Boundary sites are kept in a list with O(1) insertion and
+// removal, and time advances by 1/(number of boundary sites) per attempt so
+// that it is measured in Monte Carlo steps of the whole lattice. The proposal
+// probability depends on the number |A| of boundary sites and on the number
+// n of nearest neighbours in the copied cell, so the Metropolis acceptance
+// includes the Hastings factor |A| n_old/(|A'| n_new), with A' the boundary
+// sites after the copy, and the attempts sample the Boltzmann distribution.
+template<size_t dim, size_t q>
+class Cellular_potts_t{
+	public:
+		using Potts = Potts_t<dim, q>;
+		using spin_type = typename Potts::spin_type;
+	private:
+		static constexpr uint32_t not_active = std::numeric_limits<uint32_t>::max();
+
+		Potts& potts_m;
+		size_t n_adhesion_shells_m;
+		std::vector<uint32_t> cell_type_m;
+		std::vector<Cell_type_t> types_m;
+		// Adhesion between types, n_types x n_types
+		std::vector<double> adhesion_m;
+		std::vector<int64_t> volume_m, surface_m;
+		// Nearest neighbours with a different cell id, per site
+		std::vector<uint8_t> n_unlike_m;
+		std::vector<uint32_t> active_m, position_m;
+		std::mt19937_64 gen_m;
+		double time_m;
+		size_t n_attempts_m, n_accepted_m;
+
+		const Neighbour_table_t<dim>& nn() const {return potts_m.neighbours();}
+
+		double adhesion(const spin_type a, const spin_type b) const
+		{
+			return adhesion_m[cell_type_m[a]*types_m.size() + cell_type_m[b]];
+		}
+
+		void activate(const size_t index)
+		{
+			if(position_m[index] == not_active){
+				position_m[index] = static_cast<uint32_t>(active_m.size());
+				active_m.push_back(static_cast<uint32_t>(index));
+			}
+		}
+
+		void deactivate(const size_t index)
+		{
+			if(position_m[index] != not_active){
+				const uint32_t last = active_m.back();
+				active_m[position_m[index]] = last;
+				position_m[last] = position_m[index];
+				active_m.pop_back();
+				position_m[index] = not_active;
+			}
+		}
+
+		void update_active(const size_t index)
+		{
+			if(n_unlike_m[index] > 0){
+				activate(index);
+			}else{
+				deactivate(index);
+			}
+		}
+
+		// Constraint energy of a cell with volume v and surface area a, cells
+		// that have disappeared cost nothing
+		double constraint(const spin_type cell, const int64_t v, const int64_t a) const
+		{
+			if(cell == 0 || v == 0){
+				return 0;
+			}
+			const Cell_type_t& t = types_m[cell_type_m[cell]];
+			double res = 0;
+			if(t.target_volume >= 0){
+				res += t.lambda_volume*(static_cast<double>(v) - t.target_volume)*(static_cast<double>(v) - t.target_volume);
+			}
+			if(t.target_surface >= 0){
+				res += t.lambda_surface*(static_cast<double>(a) - t.target_surface)*(static_cast<double>(a) - t.target_surface);
+			}
+			return res;
+		}
+
+		// Copy new_spin into index and update all counters, n_old and n_new
+		// are the nearest neighbours of index in the old and new cell
+		void copy(const size_t index, const spin_type old_spin, const spin_type new_spin, const int64_t n_old, const int64_t n_new)
+		{
+			const int64_t z = static_cast<int64_t>(nn().n_neighbours(index, 0));
+			potts_m.set_spin(index, new_spin);
+			volume_m[old_spin]--;
+			volume_m[new_spin]++;
+			surface_m[old_spin] += 2*n_old - z;
+			surface_m[new_spin] += z - 2*n_new;
+			n_unlike_m[index] = static_cast<uint8_t>(z - n_new);
+			update_active(index);
+			for(auto n = nn().begin(index, 0); n != nn().end(index, 0); n++){
+				const spin_type s = potts_m.field().get(*n);
+				if(s == old_spin){
+					n_unlike_m[*n]++;
+				}else if(s == new_spin){
+					n_unlike_m[*n]--;
+				}
+				update_active(*n);
+			}
+		}
+
+		double constraint_change(const spin_type cell, const int64_t dv, const int64_t da) const
+		{
+			return constraint(cell, volume_m[cell] + dv, surface_m[cell] + da) - constraint(cell, volume_m[cell], surface_m[cell]);
+		}
+
+		// Energy change of copying new_spin into index, and the number of
+		// nearest neighbours of index in the old and the new cell
+		double delta_energy(const size_t index, const spin_type old_spin, const spin_type new_spin, int64_t& n_old, int64_t& n_new) const
+		{
+			const auto& field = potts_m.field();
+			double res = 0;
+			n_old = 0;
+			n_new = 0;
+			for(size_t shell = 0; shell < n_adhesion_shells_m; shell++){
+				for(auto n = nn().begin(index, shell); n != nn().end(index, shell); n++){
+					const spin_type s = field.get(*n);
+					res += (s != new_spin ? adhesion(new_spin, s) : 0) - (s != old_spin ? adhesion(old_spin, s) : 0);
+					if(shell == 0){
+						n_old += s == old_spin;
+						n_new += s == new_spin;
+					}
+				}
+			}
+			const int64_t z = static_cast<int64_t>(nn().n_neighbours(index, 0));
+			res += constraint_change(old_spin, -1, 2*n_old - z);
+			res += constraint_change(new_spin, 1, z - 2*n_new);
+			return res;
+		}
+
+	public:
+		// n_types cell types, every cell starts out as type 1 and the medium as
+		// type 0. Adhesion is summed over n_adhesion_shells neighbour shells of
+		// potts, which must have at least that many.
+		Cellular_potts_t(Potts& potts, const size_t n_types = 2, const size_t n_adhesion_shells = 1, const uint64_t seed = std::random_device()())
+		 : potts_m(potts), n_adhesion_shells_m(n_adhesion_shells), cell_type_m(q, 1), types_m(n_types),
+		 adhesion_m(n_types*n_types, 0), volume_m(q, 0), surface_m(q, 0), n_unlike_m(), active_m(), position_m(),
+		 gen_m(seed), time_m(0), n_attempts_m(0), n_accepted_m(0)
+		{
+			if(n_types < 2){
+				throw std::invalid_argument("Cellular Potts models need the medium and at least one cell type");
+			}
+			if(n_adhesion_shells_m == 0 || n_adhesion_shells_m > nn().n_shells()){
+				throw std::invalid_argument("Not enough neighbour shells for the adhesion energy");
+			}
+			cell_type_m[0] = 0;
+			reset();
+		}
+
+		// Recompute all counters from the spins of the Potts model, needed after
+		// changing them from outside
+		void reset()
+		{
+			const auto& field = potts_m.field();
+			const size_t n_sites = field.size();
+			std::fill(volume_m.begin(), volume_m.end(), 0);
+			std::fill(surface_m.begin(), surface_m.end(), 0);
+			n_unlike_m.assign(n_sites, 0);
+			active_m.clear();
+			position_m.assign(n_sites, not_active);
+			for(size_t i = 0; i < n_sites; i++){
+				const spin_type s = field.get(i);
+				if(nn().n_neighbours(i, 0) > std::numeric_limits<uint8_t>::max()){
+					throw std::invalid_argument("Too many nearest neighbours");
+				}
+				volume_m[s]++;
+				for(auto n = nn().begin(i, 0); n != nn().end(i, 0); n++){
+					n_unlike_m[i] += field.get(*n) != s;
+				}
+				surface_m[s] += n_unlike_m[i];
+				update_active(i);
+			}
+		}
+
+		void set_cell_type(const spin_type cell, const size_t type){cell_type_m[cell] = static_cast<uint32_t>(type);}
+		size_t cell_type(const spin_type cell) const {return cell_type_m[cell];}
+		void set_type_parameters(const size_t type, const Cell_type_t& parameters){types_m[type] = parameters;}
+		const Cell_type_t& type_parameters(const size_t type) const {return types_m[type];}
+
+		// Symmetric adhesion energy per unlike neighbour pair of types a and b
+		void set_adhesion(const size_t a, const size_t b, const double J)
+		{
+			adhesion_m[a*types_m.size() + b] = J;
+			adhesion_m[b*types_m.size() + a] = J;
+		}
+
+		int64_t volume(const spin_type cell) const {return volume_m[cell];}
+		int64_t surface(const spin_type cell) const {return surface_m[cell];}
+		size_t n_boundary_sites() const {return active_m.size();}
+		double time() const {return time_m;}
+		size_t n_attempts() const {return n_attempts_m;}
+		size_t n_accepted() const {return n_accepted_m;}
+
+		// One copy attempt at a random boundary site, returns true if accepted
+		bool attempt()
+		{
+			if(active_m.empty()){
+				return false;
+			}
+			std::uniform_int_distribution<size_t> dist_a(0, active_m.size() - 1);
+			const size_t index = active_m[dist_a(gen_m)];
+			time_m += 1./static_cast<double>(active_m.size());
+			n_attempts_m++;
+
+			std::uniform_int_distribution<size_t> dist_n(0, nn().n_neighbours(index, 0) - 1);
+			const size_t source = nn().begin(index, 0)[dist_n(gen_m)];
+			const spin_type old_spin = potts_m.field().get(index), new_spin = potts_m.field().get(source);
+			if(old_spin == new_spin){
+				return false;
+			}
+
+			int64_t n_old, n_new;
+			const double delta_e = delta_energy(index, old_spin, new_spin, n_old, n_new);
+			// Without a neighbour in the old cell the copy cannot be undone
+			if(n_old == 0){
+				return false;
+			}
+			std::uniform_real_distribution<double> dist_d(0., 1.);
+			const double r = dist_d(gen_m);
+			const double boltzmann = std::exp(-potts_m.beta()*delta_e);
+			// Only neighbours of index can leave the boundary, index stays on it
+			const size_t z = nn().n_neighbours(index, 0);
+			const double n_active = static_cast<double>(active_m.size());
+			const double min_active = static_cast<double>(active_m.size() > z + 1 ? active_m.size() - z : 1);
+			if(r >= boltzmann*n_active*static_cast<double>(n_old)/(min_active*static_cast<double>(n_new))){
+				return false;
+			}
+
+			// |A'| is only known after the copy, undo it if rejected
+			copy(index, old_spin, new_spin, n_old, n_new);
+			if(r >= boltzmann*n_active*static_cast<double>(n_old)/(static_cast<double>(active_m.size())*static_cast<double>(n_new))){
+				copy(index, new_spin, old_spin, n_new, n_old);
+				return false;
+			}
+			n_accepted_m++;
+			return true;
+		}
+
+		// Copy attempts until the time has advanced by n_steps Monte Carlo steps
+		void run(const double n_steps)
+		{
+			const double stop = time_m + n_steps;
+			while(time_m < stop && !active_m.empty()){
+				attempt();
+			}
+		}
+
+		// Energy of the current configuration, costs O(N z)
+		double total_energy() const
+		{
+			const auto& field = potts_m.field();
+			double res = 0;
+			for(size_t i = 0; i < field.size(); i++){
+				const spin_type s = field.get(i);
+				for(size_t shell = 0; shell < n_adhesion_shells_m; shell++){
+					for(auto n = nn().begin(i, shell); n != nn().end(i, shell); n++){
+						const spin_type t = field.get(*n);
+						res += t != s ? adhesion(s, t)/2 : 0;
+					}
+				}
+			}
+			for(size_t cell = 1; cell < q; cell++){
+				res += constraint(static_cast<spin_type>(cell), volume_m[cell], surface_m[cell]);
+			}
+			return res;
+		}
+};
+
+template<size_t dim, size_t q> constexpr uint32_t Cellular_potts_t<dim, q>::not_active;
+
+#endif // CELLULAR_POTTS_H
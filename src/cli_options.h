@@ -0,0 +1,177 @@
+#ifndef CLI_OPTIONS_H
+#define CLI_OPTIONS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include "sweep.h"
+
+// Options of the command line tools, all given as key=value. Arguments are
+// read in order, later ones override earlier ones. config=<file> reads a
+// file with one key=value per line, # starts a comment, at its place in the
+// arguments. Lists of numbers are comma separated, and every entry can be a
+// range start:stop:step (stop included).
+using Options = std::map<std::string, std::string>;
+
+inline std::string trim(const std::string& str)
+{
+	const size_t begin = str.find_first_not_of(" \t\r");
+	if(begin == std::string::npos){
+		return "";
+	}
+	return str.substr(begin, str.find_last_not_of(" \t\r") - begin + 1);
+}
+
+inline void add_option(Options& options, const std::string& arg)
+{
+	const size_t eq = arg.find('=');
+	const std::string key = trim(arg.substr(0, eq));
+	if(eq == std::string::npos || key.empty()){
+		throw std::invalid_argument("Expected key=value: " + arg);
+	}
+	const std::string value = trim(arg.substr(eq + 1));
+	if(key != "config"){
+		options[key] = value;
+		return;
+	}
+	std::ifstream file(value);
+	if(!file){
+		throw std::runtime_error("Cannot open " + value);
+	}
+	std::string line;
+	while(std::getline(file, line)){
+		line = trim(line.substr(0, line.find('#')));
+		if(!line.empty()){
+			add_option(options, line);
+		}
+	}
+}
+
+// Options from the arguments, throws on unknown keys
+inline Options read_options(const int argc, char* argv[], const std::set<std::string>& keys)
+{
+	Options options;
+	for(int i = 1; i < argc; i++){
+		add_option(options, argv[i]);
+	}
+	for(const auto& option : options){
+		if(keys.count(option.first) == 0){
+			throw std::invalid_argument("Unknown key: " + option.first);
+		}
+	}
+	return options;
+}
+
+inline std::string option(const Options& options, const std::string& key, const std::string& fallback)
+{
+	const auto it = options.find(key);
+	return it == options.end() ? fallback : it->second;
+}
+
+inline double parse_number(const std::string& value)
+{
+	size_t end = 0;
+	double res = 0;
+	try{
+		res = std::stod(value, &end);
+	}catch(const std::exception&){
+		end = std::string::npos;
+	}
+	if(end != value.size()){
+		throw std::invalid_argument("Not a number: " + value);
+	}
+	return res;
+}
+
+inline std::vector<double> parse_numbers(const std::string& values)
+{
+	std::vector<double> res;
+	std::istringstream in(values);
+	std::string token;
+	while(std::getline(in, token, ',')){
+		token = trim(token);
+		std::vector<double> parts;
+		std::istringstream range(token);
+		std::string part;
+		while(std::getline(range, part, ':')){
+			parts.push_back(parse_number(part));
+		}
+		if(parts.size() == 1){
+			res.push_back(parts[0]);
+		}else if(parts.size() == 3 && parts[2] > 0){
+			const size_t n = static_cast<size_t>(std::floor((parts[1] - parts[0])/parts[2] + 1e-9));
+			for(size_t i = 0; i <= n && parts[1] >= parts[0]; i++){
+				res.push_back(parts[0] + static_cast<double>(i)*parts[2]);
+			}
+		}else{
+			throw std::invalid_argument("Ranges are start:stop:step with a positive step: " + token);
+		}
+	}
+	if(res.empty()){
+		throw std::invalid_argument("No values given");
+	}
+	return res;
+}
+
+inline std::vector<size_t> parse_sizes(const std::string& values)
+{
+	std::vector<size_t> res;
+	for(const auto val : parse_numbers(values)){
+		if(val < 0 || val != std::floor(val)){
+			throw std::invalid_argument("Not a non-negative integer: " + values);
+		}
+		res.push_back(static_cast<size_t>(val));
+	}
+	return res;
+}
+
+inline size_t parse_size(const std::string& value)
+{
+	const std::vector<size_t> res = parse_sizes(value);
+	if(res.size() != 1){
+		throw std::invalid_argument("Expected a single integer: " + value);
+	}
+	return res.front();
+}
+
+// Full 64 bit range, for seeds
+inline uint64_t parse_u64(const std::string& value)
+{
+	size_t end = 0;
+	uint64_t res = 0;
+	if(value.empty() || value.find_first_not_of("0123456789") != std::string::npos){
+		end = std::string::npos;
+	}else{
+		try{
+			res = std::stoull(value, &end);
+		}catch(const std::exception&){
+			end = std::string::npos;
+		}
+	}
+	if(end != value.size()){
+		throw std::invalid_argument("Not a 64 bit unsigned integer: " + value);
+	}
+	return res;
+}
+
+inline Move_type parse_move(const std::string& move)
+{
+	if(move == "metropolis"){
+		return Move_type::Metropolis;
+	}else if(move == "heat_bath"){
+		return Move_type::Heat_bath;
+	}else if(move == "cluster"){
+		return Move_type::Cluster;
+	}else if(move == "swendsen_wang"){
+		return Move_type::Swendsen_Wang;
+	}
+	throw std::invalid_argument("Unknown move: " + move);
+}
+
+#endif // CLI_OPTIONS_H
@@ -0,0 +1,213 @@
+#ifndef CREUTZ_H
+#define CREUTZ_H
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "potts.h"
+#include "splitmix.h"
+
+// Microcanonical Creutz demon dynamics (Creutz, PRL 50, 1411 (1983)) for a
+// Potts_t, with as many demons as sites. The shell couplings and the field
+// must be integer multiples of energy_unit, so all energies are integers. A
+// site proposes the state (s + k) mod q, k in 1 ... q - 1 given by a hash of
+// the sweep and the site (cycling k in order biases the dynamics for q > 2),
+// the move is made if its demon can pay the energy change, and the demon
+// takes up the energy released otherwise. Site i
+// uses demon (i + shift) mod N, the shift changing every sweep so that
+// energy spreads over the lattice. The total energy of spins and demons is
+// conserved and no random numbers are used.
+//
+// The sites are coloured greedily so that no two coupled sites share a
+// colour, and a sweep updates one colour after the other with the sites of a
+// colour in parallel, which gives the same result for any number of threads
+// (for nearest neighbours on bipartite lattices this is the checkerboard).
+// The spins are unpacked into bytes for the run and written back afterwards.
+// In equilibrium the demon energies are geometrically distributed,
+// P(d) ~ exp(-beta d energy_unit), which gives the temperature.
+template<size_t dim, size_t q>
+class Creutz_demon_t{
+	static_assert(q <= 256, "Creutz_demon_t works on one byte per spin");
+	public:
+		using Potts = Potts_t<dim, q>;
+		using spin_type = typename Potts::spin_type;
+	private:
+		Potts& potts_m;
+		double unit_m;
+		std::vector<int32_t> J_m;
+		int32_t H_m;
+		std::vector<uint8_t> spins_m;
+		std::vector<int32_t> demon_m;
+		// Sites of every colour
+		std::vector<std::vector<uint32_t>> colours_m;
+		size_t n_sweeps_m;
+
+		const Neighbour_table_t<dim>& nn() const {return potts_m.neighbours();}
+
+		// Integer hash of the sweep and the site choosing the proposed state
+		static uint64_t mix(const uint64_t step, const uint64_t i)
+		{
+			return splitmix64(splitmix64(step) ^ i) >> 40;
+		}
+
+		static int32_t to_units(const double E, const double unit)
+		{
+			const double n = std::round(E/unit);
+			if(std::abs(E - n*unit) > 1e-9*std::max(1., std::abs(E)) || std::abs(n) > (1 << 20)){
+				throw std::invalid_argument("Couplings and field must be integer multiples of the energy unit");
+			}
+			return static_cast<int32_t>(n);
+		}
+
+		void setup_colours()
+		{
+			const size_t n_sites = potts_m.field().size();
+			std::vector<uint32_t> colour(n_sites, std::numeric_limits<uint32_t>::max());
+			std::vector<uint8_t> used;
+			for(size_t i = 0; i < n_sites; i++){
+				used.assign(colours_m.size() + 1, 0);
+				for(size_t shell = 0; shell < J_m.size(); shell++){
+					if(J_m[shell] == 0){
+						continue;
+					}
+					for(auto n = nn().begin(i, shell); n != nn().end(i, shell); n++){
+						if(colour[*n] < used.size()){
+							used[colour[*n]] = 1;
+						}
+					}
+				}
+				colour[i] = static_cast<uint32_t>(std::find(used.begin(), used.end(), 0) - used.begin());
+				if(colour[i] == colours_m.size()){
+					colours_m.emplace_back();
+				}
+				colours_m[colour[i]].push_back(static_cast<uint32_t>(i));
+			}
+		}
+
+		// Energy change in units of moving site i to new_spin. Shells without
+		// coupling are skipped, the colouring ignores them so their spins may
+		// be changing in other threads, and so are entries of i with itself,
+		// whose bond is satisfied whatever the spin.
+		int32_t delta_energy(const size_t i, const uint8_t old_spin, const uint8_t new_spin) const
+		{
+			int32_t res = H_m*((old_spin == 0) - (new_spin == 0));
+			for(size_t shell = 0; shell < J_m.size(); shell++){
+				if(J_m[shell] == 0){
+					continue;
+				}
+				int32_t n_same = 0;
+				for(auto n = nn().begin(i, shell); n != nn().end(i, shell); n++){
+					if(*n == i){
+						continue;
+					}
+					n_same += (spins_m[*n] == old_spin) - (spins_m[*n] == new_spin);
+				}
+				res += J_m[shell]*n_same;
+			}
+			return res;
+		}
+
+	public:
+		// Demons start out empty, set their energy before running
+		Creutz_demon_t(Potts& potts, const double energy_unit = 1)
+		 : potts_m(potts), unit_m(energy_unit), J_m(), H_m(to_units(potts.H(), energy_unit)), spins_m(),
+		 demon_m(potts.field().size(), 0), colours_m(), n_sweeps_m(0)
+		{
+			if(potts.bond_couplings()){
+				throw std::invalid_argument("Creutz demons need shell couplings, not per bond couplings");
+			}
+			const size_t n_shells = std::min(potts.J().size(), nn().n_shells());
+			for(size_t shell = 0; shell < n_shells; shell++){
+				J_m.push_back(to_units(potts.J()[shell], unit_m));
+			}
+			setup_colours();
+		}
+
+		double energy_unit() const {return unit_m;}
+		size_t n_colours() const {return colours_m.size();}
+		size_t n_sweeps() const {return n_sweeps_m;}
+		const std::vector<int32_t>& demons() const {return demon_m;}
+
+		// Every demon gets the energy d energy units
+		void set_demon_energy(const int32_t d){std::fill(demon_m.begin(), demon_m.end(), std::max(d, 0));}
+
+		// Draw the demon energies from their equilibrium distribution at beta
+		void thermalise_demons(const double beta, const uint64_t seed = std::random_device()())
+		{
+			std::mt19937_64 gen(seed);
+			std::geometric_distribution<int32_t> dist(1 - std::exp(-beta*unit_m));
+			for(auto& d : demon_m){
+				d = dist(gen);
+			}
+		}
+
+		// Total demon energy
+		double demon_energy() const
+		{
+			int64_t res = 0;
+			for(const auto d : demon_m){
+				res += d;
+			}
+			return static_cast<double>(res)*unit_m;
+		}
+
+		// Number of demons holding d energy units, for d = 0, 1, ...
+		std::vector<size_t> demon_histogram() const
+		{
+			std::vector<size_t> res(static_cast<size_t>(*std::max_element(demon_m.begin(), demon_m.end())) + 1, 0);
+			for(const auto d : demon_m){
+				res[static_cast<size_t>(d)]++;
+			}
+			return res;
+		}
+
+		// Inverse temperature from the mean demon energy <d> in units,
+		// beta = ln(1 + 1/<d>)/energy_unit for geometrically distributed demons
+		double beta() const
+		{
+			const double mean = demon_energy()/unit_m/static_cast<double>(demon_m.size());
+			return mean > 0 ? std::log(1 + 1/mean)/unit_m : std::numeric_limits<double>::infinity();
+		}
+
+		// Run n_sweeps sweeps on the spins of the Potts model
+		void run(const size_t n_sweeps)
+		{
+			const size_t n_sites = potts_m.field().size();
+			spins_m.resize(n_sites);
+			for(size_t i = 0; i < n_sites; i++){
+				spins_m[i] = static_cast<uint8_t>(potts_m.field().get(i));
+			}
+			for(size_t it = 0; it < n_sweeps; it++){
+				for(const auto& sites : colours_m){
+					const size_t n_colour = sites.size();
+					const uint32_t* const colour_sites = sites.data();
+					const size_t step = n_sweeps_m;
+					const size_t shift = static_cast<size_t>(splitmix64(step) % n_sites);
+					#pragma omp parallel for schedule(static)
+					for(size_t k = 0; k < n_colour; k++){
+						const size_t i = colour_sites[k];
+						int32_t& demon = demon_m[(i + shift) % n_sites];
+						const uint8_t old_spin = spins_m[i];
+						const uint8_t new_spin = static_cast<uint8_t>((old_spin + 1 + mix(step, i) % (q - 1)) % q);
+						const int32_t delta_e = delta_energy(i, old_spin, new_spin);
+						if(delta_e <= demon){
+							demon -= delta_e;
+							spins_m[i] = new_spin;
+						}
+					}
+				}
+				n_sweeps_m++;
+			}
+			for(size_t i = 0; i < n_sites; i++){
+				if(potts_m.field().get(i) != spins_m[i]){
+					potts_m.set_spin(i, static_cast<spin_type>(spins_m[i]));
+				}
+			}
+		}
+};
+
+#endif // CREUTZ_H
@@ -32,7 +32,10 @@ public:
 	std::vector<std::vector<Neighbours<dim>>> determine_nn_shells(const std::vector<Neighbours<dim>>& nn);
 
 	Lattice_t<dim>& lat(){return lat_m;}
+	const Lattice_t<dim>& lat() const {return lat_m;}
 	std::vector<Site_t<dim>>& sites(){return sites_m;}
+	const std::vector<Site_t<dim>>& sites() const {return sites_m;}
+	bool periodic() const {return R_m.size() != 0;}
 };
 
 
@@ -44,7 +47,7 @@ void Crystal_t<dim>::add_sites(const std::vector<GSL::Vector>& positions)
 	}
 }
 
-bool comp_norm(const GSL::Vector& a, const GSL::Vector& b)
+inline bool comp_norm(const GSL::Vector& a, const GSL::Vector& b)
 {
     return a.norm<double>() < b.norm<double>();
 }
@@ -206,17 +209,7 @@ std::vector<Neighbours<dim>> Crystal_t<dim>:: calc_nearest_neighbours(const size
 						}
 					}
 				}
-				if(i == 0){
-					std::cout << "\n";
-				}
 				if(add){
-					std::cout << "Site " << i;
-					std::cout << " step ";
-					for(auto val : current){
-						std::cout << val << " ";
-					}
-					std::cout << "\n";
-					std::cout << "R = " << R << "\n";
 					Site_t<dim> tmp(new_coords, zerov, size_m);
 					rp = sites_m[tmp.index()].pos();
 					tmp.set_pos(rp + R - sites_m[i].pos());
@@ -367,21 +360,6 @@ std::vector<std::vector<Neighbours<dim>>> Crystal_t<dim>::determine_nn_shells(co
 			res[site_idx][shell_idx].push_back( tmp );
 		}
 	}
-
-	size_t i = 0, j = 0;
-	for(auto site : res){
-		std::cout << "Site " << i;
-		j = 0;
-		for(auto n : site){
-			std::cout << "\n\tshell " << j << "\n\t\t";
-			for(auto v : n){
-				std::cout << v.index() << " : " << v.pos() << " ";
-			}
-			std::cout << "\n";
-			j++;
-		}
-		i++;
-	}
 	return res;
 }
 
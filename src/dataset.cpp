@@ -0,0 +1,92 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "potts_instances.h"
+#include "cli_options.h"
+#include "dataset.h"
+#include "GSLpp/error.h"
+
+// Dataset generator for training on Potts configurations. Usage:
+//   potts-dataset key=value ...
+// with the keys (defaults in brackets), see cli_options.h for the syntax
+//   output          directory for the shards and index.txt (dataset)
+//   dim, q, L       lattice dimension, number of states, linear size (2, 2, 32)
+//   beta            comma separated list or range start:stop:step (1)
+//   J               comma separated shell couplings (1)
+//   H               field (0)
+//   samples         samples per beta (1000)
+//   chains          chains per beta (number of threads)
+//   shard           samples per shard (4096)
+//   move            metropolis, heat_bath, cluster or swendsen_wang (cluster)
+//   thermalisation  sweeps before measuring tau_int (1000)
+//   pilot           sweeps measuring tau_int before the first sample (200)
+//   seed            (1)
+// Uses the models compiled into libpotts.
+
+template<size_t dim, size_t q>
+void generate(const Options& options)
+{
+	const size_t L = parse_size(option(options, "L", "32"));
+	std::array<size_t, dim> size;
+	size.fill(L);
+	GSL::Matrix m(dim, dim);
+	for(size_t i = 0; i < dim; i++){
+		m[i][i] = static_cast<double>(L);
+	}
+	Potts_t<dim, q> geometry(Lattice_t<dim>(m), size, true);
+	geometry.set_interaction_parameters(parse_numbers(option(options, "J", "1")));
+	geometry.set_H(parse_number(option(options, "H", "0")));
+
+	Sweep_options_t sweep_options;
+	sweep_options.move = parse_move(option(options, "move", "cluster"));
+	size_t n_threads = 1;
+#ifdef _OPENMP
+	n_threads = static_cast<size_t>(omp_get_max_threads());
+#endif
+	const std::vector<double> betas = parse_numbers(option(options, "beta", "1"));
+	const size_t samples = parse_size(option(options, "samples", "1000"));
+	const size_t chains = parse_size(option(options, "chains", std::to_string(n_threads)));
+
+	Dataset_writer_t writer(option(options, "output", "dataset"), dim, q, std::vector<size_t>(dim, L), parse_size(option(options, "shard", "4096")));
+	Dataset_generator_t<dim, q> generator(geometry, sweep_options, parse_size(option(options, "thermalisation", "1000")),
+		parse_size(option(options, "pilot", "200")), 256, parse_u64(option(options, "seed", "1")));
+	const auto start = std::chrono::steady_clock::now();
+	const double spacing = generator.generate(betas, samples, chains, writer);
+	writer.close();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << writer.n_samples() << " samples in " << seconds << " s (" << static_cast<double>(writer.n_samples())/seconds*3600 << " per hour), ";
+	std::cout << "mean spacing " << spacing << " sweeps\n";
+}
+
+int main(int argc, char* argv[])
+{
+	GSL::Error_handler e_handler;
+	e_handler.off();
+
+	try{
+		const Options options = read_options(argc, argv, {"config", "output", "dim", "q", "L", "beta", "J", "H", "samples", "chains", "shard", "move", "thermalisation", "pilot", "seed"});
+		const size_t dim = parse_size(option(options, "dim", "2"));
+		const size_t q = parse_size(option(options, "q", "2"));
+		bool found = false;
+#define POTTS_GENERATE(d, n) \
+		if(!found && dim == d && q == n){ \
+			generate<d, n>(options); \
+			found = true; \
+		}
+		POTTS_INSTANCES(POTTS_GENERATE)
+#undef POTTS_GENERATE
+		if(!found){
+			throw std::invalid_argument("libpotts has no model for dim = " + std::to_string(dim) + ", q = " + std::to_string(q));
+		}
+	}catch(const std::exception& e){
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,354 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "potts.h"
+#include "splitmix.h"
+
+// Bytes reserved for the header of a shard, one page
+static constexpr size_t dataset_header_bytes = 4096;
+
+// Labels of one sample, stored next to the spins
+struct Dataset_label_t{
+	double beta;
+	double energy;
+	double order_parameter;
+	double m2;
+	uint32_t q;
+	uint32_t chain;
+	uint64_t sweep;
+};
+
+// Header at the start of every shard, padded to dataset_header_bytes. The shard
+// holds capacity records of record_bytes bytes at spins_offset, followed by
+// capacity labels at labels_offset; only the first n_samples are valid. Spin
+// i (row major) of a record takes bits [i b, (i + 1) b) counted from the
+// least significant bit of every byte, b = bits_per_spin. All offsets are
+// multiples of the page size, so both arrays can be memory mapped as they are.
+struct Dataset_header_t{
+	char magic[8];
+	uint32_t version;
+	uint32_t dim;
+	uint32_t q;
+	uint32_t bits_per_spin;
+	uint32_t size[4];
+	uint64_t capacity;
+	uint64_t n_samples;
+	uint64_t record_bytes;
+	uint64_t spins_offset;
+	uint64_t labels_offset;
+};
+
+// Writes samples into fixed size shards shard-NNNNN.bin in a directory, and
+// an index.txt listing the shards with their number of samples and first
+// sample. Safe to call from several threads.
+class Dataset_writer_t{
+	private:
+		std::string directory_m;
+		Dataset_header_t header_m;
+		int fd_m;
+		size_t n_shards_m, n_samples_m;
+		std::vector<std::string> shards_m;
+		std::vector<size_t> shard_samples_m;
+		std::mutex lock_m;
+
+		static uint64_t round_up(const uint64_t bytes, const uint64_t align){return (bytes + align - 1)/align*align;}
+
+		void write_at(const void* data, const size_t bytes, const uint64_t offset)
+		{
+			const char* p = static_cast<const char*>(data);
+			size_t done = 0;
+			while(done < bytes){
+				const ssize_t n = pwrite(fd_m, p + done, bytes - done, static_cast<off_t>(offset + done));
+				if(n <= 0){
+					throw std::runtime_error("Could not write to " + shards_m.back());
+				}
+				done += static_cast<size_t>(n);
+			}
+		}
+
+		void write_header()
+		{
+			std::vector<char> buffer(dataset_header_bytes, 0);
+			std::memcpy(buffer.data(), &header_m, sizeof(header_m));
+			write_at(buffer.data(), buffer.size(), 0);
+		}
+
+		void close_shard()
+		{
+			if(fd_m < 0){
+				return;
+			}
+			write_header();
+			::close(fd_m);
+			fd_m = -1;
+			shard_samples_m.push_back(header_m.n_samples);
+			write_index();
+		}
+
+		void open_shard()
+		{
+			std::ostringstream name;
+			name << "shard-" << std::setw(5) << std::setfill('0') << n_shards_m++ << ".bin";
+			shards_m.push_back(name.str());
+			const std::string path = directory_m + "/" + name.str();
+			fd_m = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if(fd_m < 0){
+				throw std::runtime_error("Could not create " + path);
+			}
+			header_m.n_samples = 0;
+			if(ftruncate(fd_m, static_cast<off_t>(header_m.labels_offset + round_up(header_m.capacity*sizeof(Dataset_label_t), dataset_header_bytes))) != 0){
+				throw std::runtime_error("Could not allocate " + path);
+			}
+			write_header();
+		}
+
+		void write_index() const
+		{
+			std::ofstream index(directory_m + "/index.txt");
+			index << "# dim " << header_m.dim << " q " << header_m.q << " size";
+			for(size_t i = 0; i < header_m.dim; i++){
+				index << " " << header_m.size[i];
+			}
+			index << " bits_per_spin " << header_m.bits_per_spin << " record_bytes " << header_m.record_bytes << "\n";
+			index << "# shard n_samples first_sample\n";
+			size_t first = 0;
+			for(size_t s = 0; s < shard_samples_m.size(); s++){
+				index << shards_m[s] << " " << shard_samples_m[s] << " " << first << "\n";
+				first += shard_samples_m[s];
+			}
+		}
+
+	public:
+		// Shards of samples_per_shard configurations of a lattice of the given size
+		Dataset_writer_t(const std::string& directory, const size_t dim, const size_t q, const std::vector<size_t>& size, const size_t samples_per_shard)
+		 : directory_m(directory), header_m(), fd_m(-1), n_shards_m(0), n_samples_m(0), shards_m(), shard_samples_m(), lock_m()
+		{
+			if(dim > 4 || size.size() != dim || samples_per_shard == 0){
+				throw std::invalid_argument("Datasets hold lattices of up to four dimensions");
+			}
+			if(mkdir(directory_m.c_str(), 0755) != 0 && errno != EEXIST){
+				throw std::runtime_error("Could not create " + directory_m);
+			}
+			std::memcpy(header_m.magic, "POTTSDS1", 8);
+			header_m.version = 1;
+			header_m.dim = static_cast<uint32_t>(dim);
+			header_m.q = static_cast<uint32_t>(q);
+			header_m.bits_per_spin = q <= 2 ? 1 : (q <= 4 ? 2 : (q <= 16 ? 4 : 8));
+			if(q > 256){
+				throw std::invalid_argument("Datasets store at most 8 bits per spin");
+			}
+			size_t n_sites = 1;
+			for(size_t i = 0; i < dim; i++){
+				header_m.size[i] = static_cast<uint32_t>(size[i]);
+				n_sites *= size[i];
+			}
+			header_m.capacity = samples_per_shard;
+			header_m.record_bytes = round_up((n_sites*header_m.bits_per_spin + 7)/8, 64);
+			header_m.spins_offset = dataset_header_bytes;
+			header_m.labels_offset = dataset_header_bytes + round_up(header_m.capacity*header_m.record_bytes, dataset_header_bytes);
+		}
+
+		~Dataset_writer_t()
+		{
+			try{
+				close();
+			}catch(...){}
+		}
+
+		size_t record_bytes() const {return header_m.record_bytes;}
+		size_t bits_per_spin() const {return header_m.bits_per_spin;}
+		size_t n_samples() const {return n_samples_m;}
+
+		// Add one packed record of record_bytes() bytes
+		void write(const uint8_t* record, const Dataset_label_t& label)
+		{
+			std::lock_guard<std::mutex> guard(lock_m);
+			if(fd_m < 0 || header_m.n_samples == header_m.capacity){
+				close_shard();
+				open_shard();
+			}
+			const uint64_t k = header_m.n_samples;
+			write_at(record, header_m.record_bytes, header_m.spins_offset + k*header_m.record_bytes);
+			write_at(&label, sizeof(label), header_m.labels_offset + k*sizeof(label));
+			header_m.n_samples++;
+			n_samples_m++;
+		}
+
+		// Finish the current shard and the index
+		void close()
+		{
+			std::lock_guard<std::mutex> guard(lock_m);
+			close_shard();
+		}
+};
+
+// Integrated autocorrelation time of a series, from the correlations up to
+// max_lag kept in running sums, with Sokal's automatic window W >= c tau
+class Autocorrelation_t{
+	private:
+		size_t max_lag_m, n_m;
+		std::vector<double> history_m, products_m;
+		double sum_m;
+
+	public:
+		explicit Autocorrelation_t(const size_t max_lag = 256)
+		 : max_lag_m(max_lag), n_m(0), history_m(max_lag + 1, 0), products_m(max_lag + 1, 0), sum_m(0)
+		{}
+
+		size_t size() const {return n_m;}
+
+		void add(const double x)
+		{
+			history_m[n_m % history_m.size()] = x;
+			for(size_t k = 0; k <= std::min(n_m, max_lag_m); k++){
+				products_m[k] += x*history_m[(n_m - k) % history_m.size()];
+			}
+			sum_m += x;
+			n_m++;
+		}
+
+		// Window limited to max_lag, returns max_lag if the window does not close
+		double tau(const double c = 6) const
+		{
+			if(n_m < 2){
+				return 0.5;
+			}
+			const double mean = sum_m/static_cast<double>(n_m);
+			const double var = products_m[0]/static_cast<double>(n_m) - mean*mean;
+			if(var <= 0){
+				return 0.5;
+			}
+			double res = 0.5;
+			for(size_t k = 1; k <= std::min(max_lag_m, n_m - 1); k++){
+				res += (products_m[k]/static_cast<double>(n_m - k) - mean*mean)/var;
+				if(static_cast<double>(k) >= c*res){
+					return std::max(res, 0.5);
+				}
+			}
+			return static_cast<double>(max_lag_m);
+		}
+};
+
+// Runs chains_per_beta independent chains at every beta in parallel and
+// writes a sample every 2 tau_int sweeps of each chain, tau_int being the
+// larger of the autocorrelation times of the energy and of |M|^2 measured
+// so far in that chain. The chains share the neighbour table and couplings
+// of geometry.
+template<size_t dim, size_t q>
+class Dataset_generator_t{
+	static_assert(q <= 256, "Datasets store at most 8 bits per spin");
+	public:
+		using Potts = Potts_t<dim, q>;
+	private:
+		const Potts& geometry_m;
+		Sweep_options_t options_m;
+		size_t thermalisation_m, pilot_m, max_lag_m;
+		uint64_t seed_m;
+
+		static void pack(const Potts& potts, const size_t bits, std::vector<uint8_t>& record)
+		{
+			std::fill(record.begin(), record.end(), 0);
+			const size_t n_sites = potts.field().size();
+			for(size_t r = 0; r < n_sites; r++){
+				const size_t bit = r*bits;
+				record[bit/8] = static_cast<uint8_t>(record[bit/8] | (potts.field().get(potts.order().storage_index(r)) << (bit % 8)));
+			}
+		}
+
+	public:
+		// Chains sweep with options (measurements are not used), after
+		// thermalisation sweeps and at least pilot sweeps of measuring tau_int
+		Dataset_generator_t(const Potts& geometry, const Sweep_options_t& options = Sweep_options_t(), const size_t thermalisation = 1000,
+			const size_t pilot = 200, const size_t max_lag = 256, const uint64_t seed = std::random_device()())
+		 : geometry_m(geometry), options_m(options), thermalisation_m(thermalisation), pilot_m(pilot), max_lag_m(max_lag), seed_m(seed)
+		{
+			options_m.measure_every = 0;
+		}
+
+		// samples_per_beta samples at each beta, returns the mean sample spacing
+		// in sweeps. The first error of any chain, a shard that cannot be
+		// written say, stops the others and is rethrown.
+		double generate(const std::vector<double>& betas, const size_t samples_per_beta, const size_t chains_per_beta, Dataset_writer_t& writer)
+		{
+			const size_t n_chains = betas.size()*chains_per_beta;
+			double spacing = 0;
+			size_t n_samples = 0;
+			std::exception_ptr error;
+			std::atomic<bool> failed(false);
+			#pragma omp parallel for schedule(dynamic, 1) reduction(+:spacing, n_samples)
+			for(size_t c = 0; c < n_chains; c++){
+				if(failed){
+					continue;
+				}
+				try{
+					const double beta = betas[c/chains_per_beta];
+					const size_t k = c % chains_per_beta;
+					const size_t target = samples_per_beta/chains_per_beta + (k < samples_per_beta % chains_per_beta ? 1 : 0);
+					Potts potts(geometry_m.size(), geometry_m.order(), geometry_m.neighbour_table(), splitmix64(seed_m + c));
+					potts.set_interaction_parameters(geometry_m.J());
+					potts.set_bond_couplings(geometry_m.bond_couplings());
+					potts.set_H(geometry_m.H());
+					potts.set_beta(beta);
+					potts.track_occupation();
+					potts.sweep(thermalisation_m, options_m);
+
+					Autocorrelation_t tau_energy(max_lag_m), tau_m2(max_lag_m);
+					std::vector<uint8_t> record(writer.record_bytes());
+					size_t written = 0, next = pilot_m;
+					for(size_t it = 1; written < target && !failed; it++){
+						potts.sweep(1, options_m);
+						const Observables_t obs = potts.observables();
+						tau_energy.add(obs.energy);
+						tau_m2.add(obs.m2);
+						if(it < next){
+							continue;
+						}
+						pack(potts, writer.bits_per_spin(), record);
+						writer.write(record.data(), Dataset_label_t{beta, obs.energy, potts.order_parameter(), obs.m2,
+							static_cast<uint32_t>(q), static_cast<uint32_t>(c), potts.n_sweeps()});
+						written++;
+						const size_t step = static_cast<size_t>(std::ceil(2*std::max(tau_energy.tau(), tau_m2.tau())));
+						next = it + std::max<size_t>(step, 1);
+						spacing += static_cast<double>(std::max<size_t>(step, 1));
+						n_samples++;
+					}
+				}catch(...){
+					// Exceptions must not leave the parallel region, the first one is
+					// rethrown after it
+					#pragma omp critical(dataset_error)
+					{
+						if(!error){
+							error = std::current_exception();
+						}
+					}
+					failed = true;
+				}
+			}
+			if(error){
+				std::rethrow_exception(error);
+			}
+			return n_samples > 0 ? spacing/static_cast<double>(n_samples) : 0;
+		}
+};
+
+#endif // DATASET_H
@@ -0,0 +1,197 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include "potts.h"
+#include "splitmix.h"
+
+// K independent replicas of one lattice, stored interleaved by site so that
+// the spins of site i in all replicas, field[i*K + r], are contiguous. The
+// neighbour table and couplings are shared, every replica has its own beta,
+// H and xorshift random number stream. A Metropolis move of one site is done
+// for all K replicas at once in loops the compiler can vectorise.
+template<size_t dim, size_t q, size_t K>
+class Ensemble_t{
+	static_assert(q <= 256, "Ensemble_t stores one byte per spin");
+	public:
+		using Potts = Potts_t<dim, q>;
+		using spin_type = uint8_t;
+		using Bonds = typename Potts::Bonds;
+	private:
+		Site_order_t<dim> order_m;
+		std::shared_ptr<const Neighbour_table_t<dim>> nn_table_m;
+		std::shared_ptr<const Bonds> bonds_m;
+		std::vector<double> J_m;
+		Lattice_vector<spin_type> field_m;
+		std::array<float, K> beta_m, H_m;
+		std::array<uint64_t, K> rng_m;
+		size_t n_sites_m;
+
+		static uint64_t xorshift(uint64_t& x)
+		{
+			x ^= x << 13;
+			x ^= x >> 7;
+			x ^= x << 17;
+			return x;
+		}
+
+		template<class F>
+		void for_each_coupled_neighbour(const size_t index, F f) const
+		{
+			::for_each_coupled_neighbour(*nn_table_m, bonds_m.get(), J_m, index, f);
+		}
+
+		void update_site(const size_t index)
+		{
+			spin_type* const spins = field_m.data();
+			spin_type* const row = spins + index*K;
+			alignas(64) std::array<spin_type, K> old_spin, new_spin;
+			alignas(64) std::array<float, K> delta_e, u;
+
+			#pragma omp simd
+			for(size_t r = 0; r < K; r++){
+				const uint64_t x1 = xorshift(rng_m[r]);
+				const uint64_t x2 = xorshift(rng_m[r]);
+				old_spin[r] = row[r];
+				// Uniform in [1, q - 1] from the high bits of x1
+				uint32_t step = static_cast<uint32_t>(1 + (((x1 >> 32)*(q - 1)) >> 32));
+				uint32_t s = old_spin[r] + step;
+				new_spin[r] = static_cast<spin_type>(s >= q ? s - q : s);
+				u[r] = static_cast<float>(x2 >> 40)*(1.f/16777216.f);
+				delta_e[r] = H_m[r]*static_cast<float>((old_spin[r] == 0) - (new_spin[r] == 0));
+			}
+
+			for_each_coupled_neighbour(index, [&](const size_t n, const double J){
+				const spin_type* const other = spins + n*K;
+				const float Jf = static_cast<float>(J);
+				#pragma omp simd
+				for(size_t r = 0; r < K; r++){
+					delta_e[r] += Jf*static_cast<float>((other[r] == old_spin[r]) - (other[r] == new_spin[r]));
+				}
+			});
+
+			#pragma omp simd
+			for(size_t r = 0; r < K; r++){
+				const bool accept = delta_e[r] <= 0 || u[r] < std::exp(-beta_m[r]*delta_e[r]);
+				row[r] = accept ? new_spin[r] : old_spin[r];
+			}
+		}
+
+	public:
+		// Replicas of the lattice, couplings and site ordering of geometry.
+		// Every replica starts from its own random configuration.
+		Ensemble_t(const Potts& geometry, const uint64_t seed = std::random_device()())
+		 : order_m(geometry.order()), nn_table_m(geometry.neighbour_table()),
+		 bonds_m(geometry.bond_couplings()), J_m(geometry.J()), field_m(), beta_m(), H_m(), rng_m(),
+		 n_sites_m(geometry.field().size())
+		{
+			beta_m.fill(static_cast<float>(geometry.beta()));
+			H_m.fill(static_cast<float>(geometry.H()));
+			this->seed(seed);
+			field_m.resize(n_sites_m*K);
+			for(size_t i = 0; i < field_m.size(); i++){
+				field_m[i] = static_cast<spin_type>(((xorshift(rng_m[i % K]) >> 32)*q) >> 32);
+			}
+		}
+
+		static constexpr size_t n_replicas(){return K;}
+		size_t n_sites() const {return n_sites_m;}
+
+		void seed(uint64_t s)
+		{
+			for(auto& state : rng_m){
+				// xorshift must not start from zero
+				do{
+					state = splitmix64_next(s);
+				}while(state == 0);
+			}
+		}
+
+		void set_beta(const size_t replica, const double beta){beta_m[replica] = static_cast<float>(beta);}
+		void set_H(const size_t replica, const double H){H_m[replica] = static_cast<float>(H);}
+		double beta(const size_t replica) const {return beta_m[replica];}
+		double H(const size_t replica) const {return H_m[replica];}
+
+		spin_type spin(const size_t index, const size_t replica) const {return field_m[index*K + replica];}
+
+		// Configuration of one replica in row major order
+		std::vector<spin_type> snapshot(const size_t replica) const
+		{
+			std::vector<spin_type> res(n_sites_m);
+			for(size_t i = 0; i < n_sites_m; i++){
+				res[i] = field_m[i*K + replica];
+			}
+			return order_m.to_row_major(res);
+		}
+
+		void load_snapshot(const size_t replica, const std::vector<spin_type>& spins)
+		{
+			const std::vector<spin_type> stored = order_m.to_storage(spins);
+			for(size_t i = 0; i < n_sites_m; i++){
+				field_m[i*K + replica] = stored[i];
+			}
+		}
+
+		// Sequential Metropolis sweeps of all replicas
+		void sweep(const size_t n_sweeps = 1)
+		{
+			for(size_t it = 0; it < n_sweeps; it++){
+				for(size_t i = 0; i < n_sites_m; i++){
+					update_site(i);
+				}
+			}
+		}
+
+		std::array<double, K> total_energies() const
+		{
+			std::array<double, K> res;
+			res.fill(0);
+			const spin_type* const spins = field_m.data();
+			for(size_t i = 0; i < n_sites_m; i++){
+				const spin_type* const row = spins + i*K;
+				for_each_coupled_neighbour(i, [&](const size_t n, const double J){
+					const spin_type* const other = spins + n*K;
+					for(size_t r = 0; r < K; r++){
+						res[r] -= J/2*(other[r] == row[r]);
+					}
+				});
+				for(size_t r = 0; r < K; r++){
+					res[r] -= H_m[r]*(row[r] == 0);
+				}
+			}
+			return res;
+		}
+
+		std::array<double, K> average_site_energies() const
+		{
+			std::array<double, K> res = total_energies();
+			for(auto& val : res){
+				val /= static_cast<double>(n_sites_m);
+			}
+			return res;
+		}
+
+		// Average spin value of every replica, as Potts_t::magnetization
+		std::array<double, K> magnetizations() const
+		{
+			std::array<uint64_t, K> sum;
+			sum.fill(0);
+			for(size_t i = 0; i < n_sites_m; i++){
+				for(size_t r = 0; r < K; r++){
+					sum[r] += field_m[i*K + r];
+				}
+			}
+			std::array<double, K> res;
+			for(size_t r = 0; r < K; r++){
+				res[r] = static_cast<double>(sum[r])/static_cast<double>(n_sites_m);
+			}
+			return res;
+		}
+};
+
+#endif // ENSEMBLE_H
@@ -0,0 +1,281 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include "potts_instances.h"
+#include "cli_options.h"
+#include "exact_enumeration.h"
+#include "transfer_matrix.h"
+#include "nfold.h"
+#include "GSLpp/error.h"
+
+// Exact thermodynamics of small lattices by enumerating all configurations.
+// Usage:
+//   potts-enumerate key=value ...
+// with the keys (defaults in brackets), see cli_options.h for the syntax
+//   dim, q, L       lattice dimension, number of states, linear size (2, 2, 4)
+//   periodic        periodic boundaries, 0 or 1 (1)
+//   beta            comma separated list or range start:stop:step (1)
+//   J               comma separated shell couplings (1)
+//   H               field (0)
+//   dos             file to write the density of states to, one level per
+//                   line with the bonds per shell, n_0 and the count (none)
+//   check           1 runs the self test of make check instead (0)
+// Uses the models compiled into libpotts.
+
+template<size_t dim, size_t q>
+void enumerate(const Options& options)
+{
+	const size_t L = parse_size(option(options, "L", "4"));
+	std::array<size_t, dim> size;
+	size.fill(L);
+	GSL::Matrix m(dim, dim);
+	for(size_t i = 0; i < dim; i++){
+		m[i][i] = static_cast<double>(L);
+	}
+	Potts_t<dim, q> potts(Lattice_t<dim>(m), size, parse_size(option(options, "periodic", "1")) != 0);
+	potts.set_interaction_parameters(parse_numbers(option(options, "J", "1")));
+	potts.set_H(parse_number(option(options, "H", "0")));
+
+	Exact_enumeration_t<dim, q> enumeration(potts);
+	const auto start = std::chrono::steady_clock::now();
+	enumeration.enumerate();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const auto levels = enumeration.density_of_states();
+	std::cout << "# " << enumeration.n_sites() << " sites, " << enumeration.n_configurations() << " configurations, ";
+	std::cout << levels.size() << " levels, " << seconds << " s\n";
+
+	const std::string dos = option(options, "dos", "");
+	if(!dos.empty()){
+		std::ofstream out(dos);
+		for(const auto& level : levels){
+			for(const size_t b : level.bonds){
+				out << b << " ";
+			}
+			out << level.n_zero << " " << level.count << "\n";
+		}
+	}
+
+	std::cout << "# beta log_Z free_energy energy specific_heat zero_fraction zero_susceptibility\n";
+	std::cout.precision(12);
+	for(const double beta : parse_numbers(option(options, "beta", "1"))){
+		const Enumeration_result_t res = enumeration.thermodynamics(beta);
+		std::cout << res.beta << " " << res.log_Z << " " << res.free_energy << " " << res.energy << " " << res.specific_heat << " ";
+		std::cout << res.zero_fraction << " " << res.zero_susceptibility << "\n";
+	}
+}
+
+// Periodic L x L model with the given couplings and field
+template<size_t q>
+Potts_t<2, q> square(const size_t L, const std::vector<double>& J, const double H)
+{
+	GSL::Matrix m(2, 2);
+	m[0][0] = m[1][1] = static_cast<double>(L);
+	Potts_t<2, q> potts(Lattice_t<2>(m), {L, L}, true);
+	potts.set_interaction_parameters(J);
+	potts.set_H(H);
+	return potts;
+}
+
+static bool report(const std::string& what, const double value, const double expected, const double tolerance)
+{
+	const bool ok = std::abs(value - expected) <= tolerance;
+	std::cout << (ok ? "ok     " : "FAILED ") << what << ": " << value << ", expected " << expected << " +- " << tolerance << "\n";
+	return ok;
+}
+
+// Enumeration against a direct sum over all configurations using
+// Potts_t::total_energy()
+template<size_t q>
+bool check_brute_force(const double beta)
+{
+	Potts_t<2, q> potts = square<q>(3, {1, 0.3}, 0.2);
+	Exact_enumeration_t<2, q> enumeration(potts);
+	enumeration.enumerate();
+	const Enumeration_result_t exact = enumeration.thermodynamics(beta);
+
+	const size_t N = potts.field().size();
+	std::vector<double> E, n_zero;
+	for(size_t c = 0; c < static_cast<size_t>(std::pow(q, N)); c++){
+		size_t rest = c, zeros = 0;
+		for(size_t i = 0; i < N; i++){
+			potts.set_spin(i, static_cast<typename Potts_t<2, q>::spin_type>(rest % q));
+			zeros += rest % q == 0;
+			rest /= q;
+		}
+		E.push_back(potts.total_energy());
+		n_zero.push_back(static_cast<double>(zeros));
+	}
+	const double E_min = *std::min_element(E.begin(), E.end());
+	double Z = 0, E1 = 0, E2 = 0, n1 = 0;
+	for(size_t c = 0; c < E.size(); c++){
+		const double w = std::exp(-beta*(E[c] - E_min));
+		Z += w;
+		E1 += w*E[c];
+		E2 += w*E[c]*E[c];
+		n1 += w*n_zero[c];
+	}
+	E1 /= Z;
+	E2 /= Z;
+	const std::string what = "3x3 q = " + std::to_string(q) + " beta = " + std::to_string(beta) + " brute force ";
+	bool ok = report(what + "log_Z", exact.log_Z, std::log(Z) - beta*E_min, 1e-10);
+	ok &= report(what + "energy", exact.energy, E1/static_cast<double>(N), 1e-10);
+	ok &= report(what + "specific heat", exact.specific_heat, beta*beta*(E2 - E1*E1)/static_cast<double>(N), 1e-9);
+	ok &= report(what + "zero fraction", exact.zero_fraction, n1/(Z*static_cast<double>(N)), 1e-10);
+	return ok;
+}
+
+// Mean and error from 32 bins of a time series
+static std::pair<double, double> binned(const std::vector<double>& series)
+{
+	const size_t n_bins = 32, bin = series.size()/n_bins;
+	std::vector<double> means(n_bins, 0);
+	double mean = 0;
+	for(size_t b = 0; b < n_bins; b++){
+		for(size_t i = b*bin; i < (b + 1)*bin; i++){
+			means[b] += series[i]/static_cast<double>(bin);
+		}
+		mean += means[b]/static_cast<double>(n_bins);
+	}
+	double var = 0;
+	for(const auto m : means){
+		var += (m - mean)*(m - mean);
+	}
+	return std::make_pair(mean, std::sqrt(var/static_cast<double>(n_bins*(n_bins - 1))));
+}
+
+// Short runs of every move type and of the n-fold way against the
+// enumeration, within four standard errors. Wolff moves ignore the field, so
+// they only run at H = 0.
+template<size_t q>
+bool check_monte_carlo(const double beta, const double H)
+{
+	Potts_t<2, q> potts = square<q>(3, {1}, H);
+	Exact_enumeration_t<2, q> enumeration(potts);
+	enumeration.enumerate();
+	const Enumeration_result_t exact = enumeration.thermodynamics(beta);
+	potts.set_beta(beta);
+
+	const std::vector<std::pair<Move_type, std::string>> moves{{Move_type::Metropolis, "Metropolis"},
+		{Move_type::Heat_bath, "heat bath"}, {Move_type::Cluster, "Wolff"}, {Move_type::Swendsen_Wang, "Swendsen-Wang"}};
+	bool ok = true;
+	uint64_t seed = 1;
+	std::vector<double> energy, zero_fraction;
+	const auto record = [&](const double e){
+		size_t zeros = 0;
+		for(size_t i = 0; i < potts.field().size(); i++){
+			zeros += potts.field().get(i) == 0;
+		}
+		energy.push_back(e);
+		zero_fraction.push_back(static_cast<double>(zeros)/static_cast<double>(potts.field().size()));
+	};
+	const auto compare = [&](const std::string& name){
+		const std::string what = "3x3 q = " + std::to_string(q) + " beta = " + std::to_string(beta) + " H = " + std::to_string(H) + " " + name + " ";
+		const auto e = binned(energy), z = binned(zero_fraction);
+		bool res = report(what + "energy", e.first, exact.energy, 4*e.second);
+		res &= report(what + "zero fraction", z.first, exact.zero_fraction, 4*z.second);
+		energy.clear();
+		zero_fraction.clear();
+		return res;
+	};
+	for(const auto& move : moves){
+		if(move.first == Move_type::Cluster && H != 0){
+			continue;
+		}
+		potts.seed(seed++);
+		Sweep_options_t options;
+		options.move = move.first;
+		potts.sweep(1000, options);
+		options.measure_every = 1;
+		options.measure = [&](const Observables_t& obs){
+			record(obs.energy);
+		};
+		potts.sweep(200000, options);
+		ok &= compare(move.second);
+	}
+
+	// The n-fold way moves in continuous time, so it is sampled at fixed
+	// times rather than after every flip
+	Nfold_t<2, q> nfold(potts, seed);
+	nfold.set_beta(beta);
+	nfold.run(1000);
+	for(size_t t = 0; t < 200000; t++){
+		nfold.run(1);
+		record(potts.observables().energy);
+	}
+	ok &= compare("n-fold way");
+	return ok;
+}
+
+// Enumeration of the periodic 5x5 Ising model against the trace of the fifth
+// power of the transfer matrix of its rows
+static bool check_transfer_matrix(const double beta)
+{
+	const size_t W = 5;
+	Potts_t<2, 2> potts = square<2>(W, {1}, 0.2);
+	Exact_enumeration_t<2, 2> enumeration(potts);
+	enumeration.enumerate();
+	Transfer_matrix_t<2, 2> transfer(potts);
+	double trace = 0;
+	std::vector<double> v(transfer.n_states()), w;
+	for(size_t x = 0; x < transfer.n_states(); x++){
+		std::fill(v.begin(), v.end(), 0);
+		v[x] = 1;
+		for(size_t l = 0; l < W; l++){
+			transfer.apply(beta, v, w);
+			v.swap(w);
+		}
+		trace += v[x];
+	}
+	const double log_trace = std::log(trace) + static_cast<double>(W)*beta*transfer.energy_shift();
+	return report("5x5 q = 2 beta = " + std::to_string(beta) + " transfer matrix log_Z", log_trace, enumeration.thermodynamics(beta).log_Z, 1e-9);
+}
+
+static bool check()
+{
+	std::cout.precision(10);
+	bool ok = true;
+	for(const double beta : {0.3, 1.}){
+		ok &= check_brute_force<2>(beta);
+		ok &= check_brute_force<3>(beta);
+		ok &= check_transfer_matrix(beta);
+	}
+	ok &= check_monte_carlo<2>(0.4, 0);
+	ok &= check_monte_carlo<3>(0.6, 0);
+	ok &= check_monte_carlo<3>(0.6, 0.2);
+	std::cout << (ok ? "All checks passed\n" : "Some checks FAILED\n");
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	GSL::Error_handler e_handler;
+	e_handler.off();
+
+	try{
+		const Options options = read_options(argc, argv, {"config", "dim", "q", "L", "periodic", "beta", "J", "H", "dos", "check"});
+		if(parse_size(option(options, "check", "0")) != 0){
+			return check() ? 0 : 1;
+		}
+		const size_t dim = parse_size(option(options, "dim", "2"));
+		const size_t q = parse_size(option(options, "q", "2"));
+		bool found = false;
+#define POTTS_ENUMERATE(d, n) \
+		if(!found && dim == d && q == n){ \
+			enumerate<d, n>(options); \
+			found = true; \
+		}
+		POTTS_INSTANCES(POTTS_ENUMERATE)
+#undef POTTS_ENUMERATE
+		if(!found){
+			throw std::invalid_argument("libpotts has no model for dim = " + std::to_string(dim) + ", q = " + std::to_string(q));
+		}
+	}catch(const std::exception& e){
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,307 @@
+#ifndef EXACT_ENUMERATION_H
+#define EXACT_ENUMERATION_H
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "potts.h"
+
+// Thermodynamics from the exact density of states at one beta, per site
+struct Enumeration_result_t{
+	double beta;
+	double log_Z;
+	double free_energy;
+	double energy;
+	double specific_heat;
+	// Fraction of spins in state 0, the state the field couples to, and
+	// N (<n_0^2> - <n_0>^2)/N^2
+	double zero_fraction;
+	double zero_susceptibility;
+};
+
+// Level of the density of states, the number of satisfied bonds in each
+// interaction shell and the number of spins in state 0, with the number of
+// configurations at it
+struct Enumeration_level_t{
+	std::vector<size_t> bonds;
+	size_t n_zero;
+	uint64_t count;
+};
+
+// Exact enumeration of all q^N configurations of a Potts_t, for systems up to
+// about 10^12 configurations. The energy of a configuration only depends on
+// the number of satisfied bonds b_k in each shell with a coupling and on the
+// number n_0 of spins in state 0,
+//   E = -sum_k J_k b_k - H n_0,
+// so the density of states in (b_k, n_0) is counted exactly in integers and
+// gives Z(beta) and its moments for any J and H, and is independent of the
+// couplings of the model.
+//
+// The configurations are walked in reflected q-ary Gray code order (Knuth,
+// TAOCP 7.2.1.1, Algorithm H), so every step changes one spin by one and the
+// counts are updated from its neighbours in the neighbour table. The first
+// spin is left out of the walk, at each step all its q states are counted at
+// once from the states of its neighbours. Threads take fixed values of the
+// last spins in storage order, each with its own histogram. The states
+// 1, ..., q - 1 are equivalent, so the last spin is only enumerated in the
+// states 0 and 1, the latter counted q - 1 times. Per bond couplings are not
+// supported.
+template<size_t dim, size_t q>
+class Exact_enumeration_t{
+	private:
+		size_t n_sites_m, n_shells_m, n_levels_m;
+		std::vector<double> J_m;
+		double H_m;
+		// Neighbour entries of a site with itself are always satisfied
+		std::vector<size_t> self_m, max_bonds_m, stride_m;
+		// Neighbours of each site other than itself, with the histogram
+		// stride of their shell
+		std::vector<size_t> offsets_m;
+		std::vector<uint32_t> neighbours_m;
+		std::vector<int64_t> strides_m;
+		std::vector<uint64_t> histogram_m;
+
+		static bool pow_fits(size_t n, const double limit)
+		{
+			return static_cast<double>(n)*std::log(static_cast<double>(q)) < std::log(limit);
+		}
+
+		// Histogram index of the configuration of all sites but the first,
+		// every bond is seen from both ends
+		size_t evaluate(const std::vector<uint8_t>& spins) const
+		{
+			size_t bonds = 0, n_zero = 0;
+			for(size_t i = 1; i < n_sites_m; i++){
+				n_zero += spins[i] == 0;
+				for(size_t e = offsets_m[i]; e < offsets_m[i + 1]; e++){
+					bonds += spins[neighbours_m[e]] == spins[i] ? static_cast<size_t>(strides_m[e]) : 0;
+				}
+			}
+			return bonds/2 + n_zero*stride_m[n_shells_m];
+		}
+
+		// Gray code walk over the spins 1 to n_free - 1 with the others fixed,
+		// at each step counting all q states of the first spin at once
+		void walk(std::vector<uint8_t>& spins, const size_t n_free, const uint64_t weight, uint64_t* histogram) const
+		{
+			const size_t n_digits = n_free - 1;
+			std::vector<uint8_t> direction(n_digits + 1, 1);
+			std::vector<size_t> focus(n_digits + 1);
+			for(size_t d = 0; d <= n_digits; d++){
+				focus[d] = d;
+			}
+			const int64_t zero_stride = static_cast<int64_t>(stride_m[n_shells_m]);
+			size_t index = evaluate(spins);
+			std::array<size_t, q> first;
+			while(true){
+				first.fill(index);
+				first[0] += static_cast<size_t>(zero_stride);
+				for(size_t e = offsets_m[0]; e < offsets_m[1]; e++){
+					first[spins[neighbours_m[e]]] += static_cast<size_t>(strides_m[e]);
+				}
+				for(size_t s = 0; s < q; s++){
+					histogram[first[s]] += weight;
+				}
+				const size_t d = focus[0];
+				focus[0] = 0;
+				if(d == n_digits){
+					break;
+				}
+				const size_t j = d + 1;
+				const uint8_t old_spin = spins[j];
+				const uint8_t new_spin = static_cast<uint8_t>(direction[d] ? old_spin + 1 : old_spin - 1);
+				int64_t delta = ((new_spin == 0) - (old_spin == 0))*zero_stride;
+				for(size_t e = offsets_m[j]; e < offsets_m[j + 1]; e++){
+					const uint8_t s = spins[neighbours_m[e]];
+					delta += ((s == new_spin) - (s == old_spin))*strides_m[e];
+				}
+				index += static_cast<size_t>(delta);
+				spins[j] = new_spin;
+				if(new_spin == 0 || new_spin == q - 1){
+					direction[d] = !direction[d];
+					focus[d] = focus[d + 1];
+					focus[d + 1] = d + 1;
+				}
+			}
+		}
+
+	public:
+		explicit Exact_enumeration_t(const Potts_t<dim, q>& model)
+		 : n_sites_m(model.field().size()), n_shells_m(std::min(model.J().size(), model.neighbours().n_shells())),
+		 n_levels_m(0), J_m(model.J()), H_m(model.H()), self_m(), max_bonds_m(), stride_m(), offsets_m(), neighbours_m(), strides_m(), histogram_m()
+		{
+			if(model.bond_couplings()){
+				throw std::invalid_argument("Exact enumeration needs shell couplings, not per bond couplings");
+			}
+			if(n_sites_m < 2 || !pow_fits(n_sites_m, 9.2e18)){
+				throw std::length_error("Too many configurations to enumerate");
+			}
+			const Neighbour_table_t<dim>& nn = model.neighbours();
+			J_m.resize(n_shells_m);
+			self_m.assign(n_shells_m, 0);
+			max_bonds_m.assign(n_shells_m, 0);
+			for(size_t i = 0; i < n_sites_m; i++){
+				for(size_t k = 0; k < n_shells_m; k++){
+					for(auto n = nn.begin(i, k); n != nn.end(i, k); n++){
+						if(*n == i){
+							self_m[k]++;
+						}else{
+							max_bonds_m[k]++;
+						}
+					}
+				}
+			}
+			n_levels_m = 1;
+			for(size_t k = 0; k <= n_shells_m; k++){
+				stride_m.push_back(n_levels_m);
+				n_levels_m *= k < n_shells_m ? max_bonds_m[k]/2 + 1 : n_sites_m + 1;
+				if(n_levels_m > (size_t(1) << 24)){
+					throw std::length_error("Too many levels in the density of states");
+				}
+			}
+			// The neighbours of the first site come first, the others leave it
+			// out as its bonds are counted separately
+			offsets_m.push_back(0);
+			for(size_t i = 0; i < n_sites_m; i++){
+				for(size_t k = 0; k < n_shells_m; k++){
+					for(auto n = nn.begin(i, k); n != nn.end(i, k); n++){
+						if(*n != i && (i == 0 || *n != 0)){
+							neighbours_m.push_back(*n);
+							strides_m.push_back(static_cast<int64_t>(stride_m[k]));
+						}
+					}
+				}
+				offsets_m.push_back(neighbours_m.size());
+			}
+		}
+
+		size_t n_sites() const {return n_sites_m;}
+		size_t n_shells() const {return n_shells_m;}
+		double n_configurations() const {return std::pow(static_cast<double>(q), static_cast<double>(n_sites_m));}
+
+		// Count all configurations, the runtime is proportional to q^N/2
+		void enumerate()
+		{
+			// Enough fixed leading spins for a few tasks per thread
+			size_t n_threads = 1;
+#ifdef _OPENMP
+			n_threads = static_cast<size_t>(omp_get_max_threads());
+#endif
+			size_t n_fixed = 1, n_tasks = 2;
+			while(n_fixed + 1 < n_sites_m && n_tasks < 16*n_threads){
+				n_fixed++;
+				n_tasks *= q;
+			}
+			const size_t n_free = n_sites_m - n_fixed;
+
+			std::vector<std::vector<uint64_t>> histograms(n_threads);
+			#pragma omp parallel
+			{
+				size_t thread = 0;
+#ifdef _OPENMP
+				thread = static_cast<size_t>(omp_get_thread_num());
+#endif
+				histograms[thread].assign(n_levels_m, 0);
+				std::vector<uint8_t> spins(n_sites_m);
+				#pragma omp for schedule(dynamic, 1)
+				for(size_t task = 0; task < n_tasks; task++){
+					std::fill(spins.begin(), spins.end(), 0);
+					size_t rest = task;
+					for(size_t i = n_free; i < n_sites_m - 1; i++){
+						spins[i] = static_cast<uint8_t>(rest % q);
+						rest /= q;
+					}
+					spins[n_sites_m - 1] = static_cast<uint8_t>(rest);
+					walk(spins, n_free, rest == 0 ? 1 : q - 1, histograms[thread].data());
+				}
+			}
+			histogram_m.assign(n_levels_m, 0);
+			for(const auto& histogram : histograms){
+				for(size_t i = 0; i < histogram.size(); i++){
+					histogram_m[i] += histogram[i];
+				}
+			}
+		}
+
+		// Non-empty levels of the density of states, after enumerate()
+		std::vector<Enumeration_level_t> density_of_states() const
+		{
+			std::vector<Enumeration_level_t> res;
+			for(size_t i = 0; i < histogram_m.size(); i++){
+				if(histogram_m[i] == 0){
+					continue;
+				}
+				Enumeration_level_t level{std::vector<size_t>(n_shells_m), i/stride_m[n_shells_m], histogram_m[i]};
+				for(size_t k = 0; k < n_shells_m; k++){
+					level.bonds[k] = (i/stride_m[k]) % (max_bonds_m[k]/2 + 1);
+				}
+				res.push_back(level);
+			}
+			return res;
+		}
+
+		// Energy of a level, as Potts_t::total_energy() with couplings J and
+		// field H
+		double energy(const Enumeration_level_t& level, const std::vector<double>& J, const double H) const
+		{
+			double res = -H*static_cast<double>(level.n_zero);
+			for(size_t k = 0; k < n_shells_m && k < J.size(); k++){
+				res -= J[k]*(static_cast<double>(level.bonds[k]) + static_cast<double>(self_m[k])/2);
+			}
+			return res;
+		}
+
+		Enumeration_result_t thermodynamics(const double beta, const std::vector<double>& J, const double H) const
+		{
+			if(histogram_m.empty()){
+				throw std::logic_error("Call enumerate() before asking for the thermodynamics");
+			}
+			const auto levels = density_of_states();
+			std::vector<double> E(levels.size()), log_w(levels.size());
+			double max_log_w = -std::numeric_limits<double>::infinity();
+			for(size_t i = 0; i < levels.size(); i++){
+				E[i] = energy(levels[i], J, H);
+				log_w[i] = std::log(static_cast<double>(levels[i].count)) - beta*E[i];
+				max_log_w = std::max(max_log_w, log_w[i]);
+			}
+			double Z = 0, E1 = 0, E2 = 0, n1 = 0, n2 = 0;
+			for(size_t i = 0; i < levels.size(); i++){
+				const double w = std::exp(log_w[i] - max_log_w);
+				const double n = static_cast<double>(levels[i].n_zero);
+				Z += w;
+				E1 += w*E[i];
+				E2 += w*E[i]*E[i];
+				n1 += w*n;
+				n2 += w*n*n;
+			}
+			E1 /= Z;
+			E2 /= Z;
+			n1 /= Z;
+			n2 /= Z;
+			const double N = static_cast<double>(n_sites_m);
+			Enumeration_result_t res;
+			res.beta = beta;
+			res.log_Z = std::log(Z) + max_log_w;
+			res.free_energy = -res.log_Z/(beta*N);
+			res.energy = E1/N;
+			res.specific_heat = beta*beta*(E2 - E1*E1)/N;
+			res.zero_fraction = n1/N;
+			res.zero_susceptibility = (n2 - n1*n1)/N;
+			return res;
+		}
+
+		// With the couplings and field of the model
+		Enumeration_result_t thermodynamics(const double beta) const
+		{
+			return thermodynamics(beta, J_m, H_m);
+		}
+};
+
+#endif // EXACT_ENUMERATION_H
@@ -0,0 +1,88 @@
+#ifndef FENWICK_H
+#define FENWICK_H
+
+#include <vector>
+#include <cstddef>
+
+// Binary indexed tree over non-negative weights, O(log n) updates, prefix
+// sums and inverse lookups of prefix sums
+class Fenwick_t{
+	private:
+		std::vector<double> tree_m, value_m;
+
+		size_t highest_bit() const
+		{
+			size_t res = 1;
+			while(2*res <= value_m.size()){
+				res *= 2;
+			}
+			return res;
+		}
+
+	public:
+		Fenwick_t() : tree_m(), value_m() {}
+		explicit Fenwick_t(const size_t n) : tree_m(n, 0), value_m(n, 0) {}
+
+		size_t size() const {return value_m.size();}
+		double get(const size_t i) const {return value_m[i];}
+
+		void add(const size_t i, const double delta)
+		{
+			value_m[i] += delta;
+			for(size_t j = i + 1; j <= tree_m.size(); j += j & (~j + 1)){
+				tree_m[j - 1] += delta;
+			}
+		}
+
+		void set(const size_t i, const double val)
+		{
+			add(i, val - value_m[i]);
+		}
+
+		// Sum of the first n weights
+		double prefix(const size_t n) const
+		{
+			double res = 0;
+			for(size_t j = n; j > 0; j -= j & (~j + 1)){
+				res += tree_m[j - 1];
+			}
+			return res;
+		}
+
+		double total() const {return prefix(value_m.size());}
+
+		// Smallest i such that the sum of the first i + 1 weights exceeds u
+		size_t find(double u) const
+		{
+			size_t pos = 0;
+			for(size_t step = highest_bit(); step > 0; step /= 2){
+				if(pos + step <= tree_m.size() && tree_m[pos + step - 1] <= u){
+					pos += step;
+					u -= tree_m[pos - 1];
+				}
+			}
+			return pos < value_m.size() ? pos : value_m.size() - 1;
+		}
+
+		// Recompute all partial sums from the stored weights, removes
+		// accumulated round off and allows growing the tree
+		void resize(const size_t n)
+		{
+			value_m.resize(n, 0);
+			rebuild();
+		}
+
+		void rebuild()
+		{
+			tree_m.assign(value_m.size(), 0);
+			for(size_t i = 0; i < value_m.size(); i++){
+				tree_m[i] += value_m[i];
+				size_t parent = (i + 1) + ((i + 1) & (~(i + 1) + 1));
+				if(parent <= tree_m.size()){
+					tree_m[parent - 1] += tree_m[i];
+				}
+			}
+		}
+};
+
+#endif // FENWICK_H
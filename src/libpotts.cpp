@@ -0,0 +1,118 @@
+#include <string>
+#include <stdexcept>
+#define POTTS_INSTANTIATE
+#include "potts_instances.h"
+#include "potts_model.h"
+
+#define POTTS_INSTANTIATE_DIM(dim) \
+	template class Lattice_t<dim>; \
+	template class Site_t<dim>; \
+	template class Crystal_t<dim>; \
+	template class Site_order_t<dim>; \
+	template class Neighbour_table_t<dim>;
+#define POTTS_INSTANTIATE_MODEL(dim, q) template class Potts_t<dim, q>;
+POTTS_DIMS(POTTS_INSTANTIATE_DIM)
+POTTS_INSTANCES(POTTS_INSTANTIATE_MODEL)
+
+namespace{
+
+template<size_t dim, size_t q>
+class Potts_model_impl_t : public Potts_model_t{
+	private:
+		Potts_t<dim, q> potts_m;
+
+		static std::array<size_t, dim> to_array(const std::vector<size_t>& size)
+		{
+			std::array<size_t, dim> res;
+			std::copy(size.begin(), size.end(), res.begin());
+			return res;
+		}
+
+		static Lattice_t<dim> cubic_lattice(const std::vector<size_t>& size)
+		{
+			GSL::Matrix m(dim, dim);
+			for(size_t i = 0; i < dim; i++){
+				m[i][i] = static_cast<double>(size[i]);
+			}
+			return Lattice_t<dim>(m);
+		}
+
+	public:
+		Potts_model_impl_t(const std::vector<size_t>& size, const bool periodic, const Site_ordering ordering, const size_t order_block)
+		 : potts_m(cubic_lattice(size), to_array(size), periodic, ordering, order_block)
+		{}
+
+		size_t dimension() const override {return dim;}
+		size_t n_states() const override {return q;}
+		std::vector<size_t> size() const override {return std::vector<size_t>(potts_m.size().begin(), potts_m.size().end());}
+		size_t n_sites() const override {return potts_m.field().size();}
+
+		void seed(const uint64_t s) override {potts_m.seed(s);}
+		void set_interaction_parameters(const std::vector<double>& J) override {potts_m.set_interaction_parameters(J);}
+		void set_H(const double H) override {potts_m.set_H(H);}
+		void set_beta(const double beta) override {potts_m.set_beta(beta);}
+		const std::vector<double>& J() const override {return potts_m.J();}
+		double H() const override {return potts_m.H();}
+		double beta() const override {return potts_m.beta();}
+
+		void sweep(const size_t n_sweeps, const Sweep_options_t& options) override {potts_m.sweep(n_sweeps, options);}
+		size_t n_sweeps() const override {return potts_m.n_sweeps();}
+		Observables_t observables() const override {return potts_m.observables();}
+		double total_energy() const override {return potts_m.total_energy();}
+		double average_site_energy() const override {return potts_m.average_site_energy();}
+		double magnetization() const override {return potts_m.magnetization();}
+		double order_parameter() const override {return potts_m.order_parameter();}
+
+		std::vector<uint32_t> snapshot() const override
+		{
+			const auto spins = potts_m.snapshot();
+			return std::vector<uint32_t>(spins.begin(), spins.end());
+		}
+
+		void load_snapshot(const std::vector<uint32_t>& spins) override
+		{
+			if(spins.size() != n_sites()){
+				throw std::invalid_argument("Snapshot does not match the lattice size");
+			}
+			std::vector<typename Potts_t<dim, q>::spin_type> res(spins.size());
+			for(size_t i = 0; i < spins.size(); i++){
+				if(spins[i] >= q){
+					throw std::invalid_argument("Spin out of range");
+				}
+				res[i] = static_cast<typename Potts_t<dim, q>::spin_type>(spins[i]);
+			}
+			potts_m.load_snapshot(res);
+		}
+
+		void add_spin_correlator(const size_t index, const double r_max) override {potts_m.add_spin_correlator(index, r_max);}
+		void average_spin_correlators(const double r_max) override {potts_m.average_spin_correlators(r_max);}
+		void reset_spin_correlators() override {potts_m.reset_spin_correlators();}
+		void measure_spin_correlators() override {potts_m.measure_spin_correlators();}
+		std::vector<std::pair<double, double>> spin_correlation() const override {return potts_m.spin_correlation();}
+};
+
+}
+
+std::unique_ptr<Potts_model_t> make_potts_model(const size_t dim, const size_t q, const std::vector<size_t>& size,
+	const bool periodic, const Site_ordering ordering, const size_t order_block)
+{
+	if(size.size() != dim){
+		throw std::invalid_argument("Lattice size needs one extent per dimension");
+	}
+#define POTTS_MAKE(d, n) \
+	if(dim == d && q == n){ \
+		return std::unique_ptr<Potts_model_t>(new Potts_model_impl_t<d, n>(size, periodic, ordering, order_block)); \
+	}
+	POTTS_INSTANCES(POTTS_MAKE)
+#undef POTTS_MAKE
+	throw std::invalid_argument("libpotts has no model for dim = " + std::to_string(dim) + ", q = " + std::to_string(q));
+}
+
+std::vector<std::pair<size_t, size_t>> potts_model_instances()
+{
+	std::vector<std::pair<size_t, size_t>> res;
+#define POTTS_LIST(d, n) res.emplace_back(d, n);
+	POTTS_INSTANCES(POTTS_LIST)
+#undef POTTS_LIST
+	return res;
+}
@@ -0,0 +1,237 @@
+#ifndef LONG_RANGE_H
+#define LONG_RANGE_H
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "potts.h"
+
+// Wolff cluster updates for a periodic Potts model where every pair of sites
+// interacts, J_ij = J(|r_ij|) summed over periodic images (Luijten and Blote,
+// Int. J. Mod. Phys. C 6, 359 (1995)). Couplings only depend on the
+// displacement between two sites, so the image sums and bond probabilities
+// are computed once per displacement. Activated bonds are found by jumping
+// along the cumulative bond probabilities instead of testing every pair,
+// making a cluster update cost O(cluster size) independent of the range.
+// Only ferromagnetic couplings form bonds.
+template<size_t dim, size_t q>
+class Long_range_t{
+	public:
+		using Potts = Potts_t<dim, q>;
+		using spin_type = typename Potts::spin_type;
+		using Displacement = std::array<size_t, dim>;
+	private:
+		Potts& potts_m;
+		std::array<size_t, dim> size_m;
+		// Displacements ordered by decreasing coupling
+		std::vector<Displacement> displacements_m;
+		std::vector<double> J_m;
+		// lambda_m[k] = -sum_{m <= k} ln(1 - p_m)
+		std::vector<double> lambda_m;
+		double mean_bonds_m;
+		std::mt19937_64 gen_m;
+
+		std::array<size_t, dim> coord(size_t row_major) const
+		{
+			std::array<size_t, dim> res;
+			for(size_t i = 0; i < dim; i++){
+				res[i] = row_major % size_m[i];
+				row_major /= size_m[i];
+			}
+			return res;
+		}
+
+		size_t row_major_index(const std::array<size_t, dim>& c) const
+		{
+			size_t res = 0;
+			for(size_t i = dim; i > 0; i--){
+				res = res*size_m[i - 1] + c[i - 1];
+			}
+			return res;
+		}
+
+		// Storage index of the site displaced by d from the site at storage index
+		size_t displaced(const size_t index, const Displacement& d) const
+		{
+			std::array<size_t, dim> c = coord(potts_m.order().row_major_index(index));
+			for(size_t i = 0; i < dim; i++){
+				c[i] = (c[i] + d[i]) % size_m[i];
+			}
+			return potts_m.order().storage_index(row_major_index(c));
+		}
+
+		void setup_couplings(const std::function<double(double)>& J, const size_t n_images)
+		{
+			const auto& sites = potts_m.crystal().sites();
+			const size_t n_sites = sites.size();
+			// Cartesian vector of a unit step along each axis
+			std::vector<GSL::Vector> a(dim, GSL::Vector(dim));
+			size_t stride = 1;
+			for(size_t i = 0; i < dim; i++){
+				if(size_m[i] > 1){
+					a[i] = sites[stride].pos() - sites[0].pos();
+				}
+				stride *= size_m[i];
+			}
+
+			std::vector<std::pair<double, Displacement>> couplings;
+			couplings.reserve(n_sites - 1);
+			const size_t n_cells = static_cast<size_t>(std::pow(2*n_images + 1, dim));
+			GSL::Vector r(dim);
+			for(size_t idx = 1; idx < n_sites; idx++){
+				const Displacement d = coord(idx);
+				double J_d = 0;
+				for(size_t cell = 0; cell < n_cells; cell++){
+					r.copy(GSL::Vector(dim));
+					size_t tmp = cell;
+					for(size_t i = 0; i < dim; i++){
+						// Minimum image of d along axis i, shifted by whole cells
+						double x = static_cast<double>(d[i]);
+						if(2*d[i] > size_m[i]){
+							x -= static_cast<double>(size_m[i]);
+						}
+						x += static_cast<double>(static_cast<long>(tmp % (2*n_images + 1)) - static_cast<long>(n_images))*static_cast<double>(size_m[i]);
+						tmp /= 2*n_images + 1;
+						r += x*a[i];
+					}
+					J_d += J(r. template norm<double>());
+				}
+				couplings.push_back(std::make_pair(J_d, d));
+			}
+			std::sort(couplings.begin(), couplings.end(),
+				[](const std::pair<double, Displacement>& x, const std::pair<double, Displacement>& y){return x.first > y.first;});
+
+			displacements_m.resize(couplings.size());
+			J_m.resize(couplings.size());
+			for(size_t k = 0; k < couplings.size(); k++){
+				J_m[k] = couplings[k].first;
+				displacements_m[k] = couplings[k].second;
+			}
+		}
+
+	public:
+		// Interactions J(r) between all pairs of sites of the periodic Potts
+		// model potts, image sums include n_images periodic cells on each side
+		// of the minimum image
+		Long_range_t(Potts& potts, const std::function<double(double)>& J, const size_t n_images = 1, const uint64_t seed = std::random_device()())
+		 : potts_m(potts), size_m(potts.size()), displacements_m(), J_m(), lambda_m(), mean_bonds_m(0), gen_m(seed)
+		{
+			if(!potts.crystal().periodic()){
+				throw std::invalid_argument("Long range interactions need a periodic lattice");
+			}
+			setup_couplings(J, n_images);
+			set_beta(potts.beta());
+		}
+
+		void set_beta(const double beta)
+		{
+			potts_m.set_beta(beta);
+			lambda_m.resize(J_m.size());
+			double sum = 0;
+			mean_bonds_m = 0;
+			for(size_t k = 0; k < J_m.size(); k++){
+				// -ln(1 - p) with p = 1 - exp(-beta J) for ferromagnetic bonds
+				if(J_m[k] > 0){
+					sum += beta*J_m[k];
+					mean_bonds_m += 1 - std::exp(-beta*J_m[k]);
+				}
+				lambda_m[k] = sum;
+			}
+		}
+
+		size_t n_displacements() const {return J_m.size();}
+		double coupling(const size_t k) const {return J_m[k];}
+		const Displacement& displacement(const size_t k) const {return displacements_m[k];}
+
+		// Expected number of activated bonds, and so of neighbours looked at,
+		// per cluster site
+		double mean_activated_bonds() const {return mean_bonds_m;}
+
+		// Grow and flip one Wolff cluster from a random site, returns the
+		// cluster size (0 if the external field rejected the flip)
+		size_t update()
+		{
+			auto& field = potts_m.field();
+			std::uniform_int_distribution<size_t> dist_i(0, field.size() - 1);
+			std::uniform_int_distribution<size_t> dist_s(0, q - 2);
+			std::uniform_real_distribution<double> dist_d(0., 1.);
+
+			const size_t seed_site = dist_i(gen_m);
+			const spin_type old_spin = field.get(seed_site);
+			const size_t s = dist_s(gen_m);
+			const spin_type new_spin = static_cast<spin_type>(s < old_spin ? s : s + 1);
+
+			std::vector<size_t> cluster{seed_site}, to_treat{seed_site};
+			potts_m.set_spin(seed_site, new_spin);
+			while(!to_treat.empty()){
+				const size_t i = to_treat.back();
+				to_treat.pop_back();
+				double lambda = 0;
+				while(true){
+					// Next activated bond: first k with lambda_k - lambda >= Exp(1)
+					lambda -= std::log(1. - dist_d(gen_m));
+					auto it = std::lower_bound(lambda_m.begin(), lambda_m.end(), lambda);
+					if(it == lambda_m.end()){
+						break;
+					}
+					lambda = *it;
+					const size_t j = displaced(i, displacements_m[static_cast<size_t>(it - lambda_m.begin())]);
+					if(field.get(j) == old_spin){
+						potts_m.set_spin(j, new_spin);
+						cluster.push_back(j);
+						to_treat.push_back(j);
+					}
+				}
+			}
+
+			// The bonds are independent of H, accept the field energy change
+			const double delta_e = potts_m.H()*static_cast<double>(cluster.size())*((old_spin == 0) - (new_spin == 0));
+			if(delta_e > 0 && dist_d(gen_m) >= std::exp(-potts_m.beta()*delta_e)){
+				for(const auto i : cluster){
+					potts_m.set_spin(i, old_spin);
+				}
+				return 0;
+			}
+			return cluster.size();
+		}
+
+		// Run cluster updates until at least n_sites spins have been flipped
+		// per sweep, n_sweeps times
+		void sweep(const size_t n_sweeps = 1)
+		{
+			const size_t n_sites = potts_m.field().size();
+			for(size_t it = 0; it < n_sweeps; it++){
+				size_t flipped = 0, attempts = 0;
+				while(flipped < n_sites && attempts < n_sites){
+					flipped += update();
+					attempts++;
+				}
+			}
+		}
+
+		// -sum_{i<j} J_ij delta(s_i, s_j) - H sum_i delta(s_i, 0), costs O(N^2)
+		double total_energy() const
+		{
+			const auto& field = potts_m.field();
+			const size_t n_sites = field.size();
+			double res = 0;
+			for(size_t i = 0; i < n_sites; i++){
+				const spin_type s = field.get(i);
+				for(size_t k = 0; k < J_m.size(); k++){
+					if(field.get(displaced(i, displacements_m[k])) == s){
+						res -= J_m[k]/2;
+					}
+				}
+				res -= potts_m.H()*(s == 0);
+			}
+			return res;
+		}
+};
+
+#endif // LONG_RANGE_H
@@ -3,9 +3,14 @@
 #include <iomanip>
 #include <fstream>
 #include <random>
-#include "lattice.h"
-#include "crystal.h"
-#include "potts.h"
+#include <string>
+#include <cstdlib>
+#include <array>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include "potts_model.h"
 #include "GSLpp/error.h"
 
 struct Bitmap_header{
@@ -136,7 +141,7 @@ void bitmap_print(const std::vector<Pixel_data>& pixels, const std::string filen
 	file.close();
 }
 
-std::vector<Pixel_data> create_bitmap_data(const std::vector<uint8_t>& field, const std::array<size_t, 2>& size, const unsigned int q = 2)
+std::vector<Pixel_data> create_bitmap_data(const std::vector<uint32_t>& field, const std::array<size_t, 2>& size, const unsigned int q = 2)
 {
 	std::vector<Pixel_data> res(field.size());
 
@@ -154,41 +159,53 @@ std::vector<Pixel_data> create_bitmap_data(const std::vector<uint8_t>& field, co
 	return res;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
 	GSL::Error_handler e_handler;
 	e_handler.off();
 
-	size_t width = 5, height = 5;
-	Lattice_t<2> lat{{{static_cast<double>(width), 0},
-		{0, static_cast<double>(height)}}};
-	Potts_t<2, 4> potts(lat, {width, height}, true);
-	potts.set_beta(10);
+	// Usage: potts [dim] [q] [L] [beta] [sweeps], bitmaps are only written in 2D
+	const size_t dim = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2;
+	const size_t q = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+	const size_t width = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 5, height = width;
+	const double beta = argc > 4 ? std::strtod(argv[4], nullptr) : 10;
+	std::unique_ptr<Potts_model_t> potts;
+	try{
+		potts = make_potts_model(dim, q, std::vector<size_t>(dim, width), true);
+	}catch(const std::invalid_argument& e){
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	potts->set_beta(beta);
 
 
 	// One interaction parameter per nearest neighbour shell to consider
-	potts.set_interaction_parameters({2.0});
-
-	std::tuple<double, int, double, double> corr;
+	potts->set_interaction_parameters({2.0});
 
+	const bool bitmaps = dim == 2;
 	std::cout << "Iterations start\n";
-	size_t num_iterations = width*height;
-	for(size_t it = 0; it < num_iterations; it++){
-		potts.update(true);
-		if(it % (num_iterations/10) == 0){
-			std::cout << "Iteration " << it << ", out of " << num_iterations <<"\n";
-			std::cout << "\tAverage energy = " << potts.average_site_energy() << "\n";
-			std::cout << "\tMagnetization = " << potts.magnetization() << "\n";
-			std::cout << "\n";
-
-			bitmap_print(create_bitmap_data(potts.field(), {width, height}, 4),
-				"Potts-" + std::to_string((10*it)/num_iterations) + ".bmp", {width, height});
+	size_t num_iterations = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : potts->n_sites();
+	Sweep_options_t options;
+	options.move = Move_type::Cluster;
+	options.measure_every = std::max<size_t>(num_iterations/10, 1);
+	options.measure = [&](const Observables_t& obs){
+		std::cout << "Iteration " << obs.sweep << ", out of " << num_iterations <<"\n";
+		std::cout << "\tAverage energy = " << obs.energy << "\n";
+		std::cout << "\tMagnetization = " << obs.magnetization << "\n";
+		std::cout << "\n";
+
+		if(bitmaps){
+			bitmap_print(create_bitmap_data(potts->snapshot(), {width, height}, static_cast<unsigned int>(q)),
+				"Potts-" + std::to_string((10*obs.sweep)/num_iterations) + ".bmp", {width, height});
 		}
-	}
+	};
+	potts->sweep(num_iterations, options);
 
-	std::cout << "Average energy = " << potts.average_site_energy() << "\n";
-	std::cout << "Magnetization = " << potts.magnetization() << "\n";
-	bitmap_print(create_bitmap_data(potts.field(), {width, height}, 4), "Final.bmp", {width, height});
+	std::cout << "Average energy = " << potts->average_site_energy() << "\n";
+	std::cout << "Magnetization = " << potts->magnetization() << "\n";
+	if(bitmaps){
+		bitmap_print(create_bitmap_data(potts->snapshot(), {width, height}, static_cast<unsigned int>(q)), "Final.bmp", {width, height});
+	}
 
 	return 0;
 }
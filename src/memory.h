@@ -0,0 +1,253 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <limits>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+enum class Page_size{Default, Transparent_huge, Explicit_huge};
+enum class Placement{First_touch, Interleaved};
+enum class Thread_pinning{None, Compact, Spread};
+
+// How lattice sized arrays (spins, neighbour tables, couplings) get their
+// memory. Allocations of at least mmap_threshold bytes are mapped directly,
+// backed by 2 MB pages if asked for, and either interleaved over all NUMA
+// nodes or placed by the first thread touching each page. With
+// parallel_first_touch every thread touches the pages starting in its share
+// of the elements, split into the contiguous equal ranges of a static
+// schedule. Arrays with the same number of entries per site (spins, the
+// neighbour indices of a fixed coordination) then put each page on the node
+// of the thread owning its first site in a static parallel loop over the
+// sites, such as total_energy(). The sweeps themselves are serial.
+struct Memory_policy_t{
+	Page_size pages = Page_size::Default;
+	Placement placement = Placement::First_touch;
+	bool parallel_first_touch = false;
+};
+
+// Policy used by all Lattice_allocator_t, set it before creating the models
+inline Memory_policy_t& memory_policy()
+{
+	static Memory_policy_t policy;
+	return policy;
+}
+
+inline void set_memory_policy(const Memory_policy_t& policy){memory_policy() = policy;}
+
+namespace memory_detail{
+	static constexpr size_t huge_page = size_t(1) << 21;
+	static constexpr size_t mmap_threshold = huge_page;
+
+	// Highest online NUMA node plus one, from sysfs
+	inline size_t n_numa_nodes()
+	{
+		static const size_t n = []{
+			std::ifstream file("/sys/devices/system/node/online");
+			std::string line;
+			size_t res = 1;
+			if(std::getline(file, line) && !line.empty()){
+				const size_t pos = line.find_last_of("-,");
+				res = std::stoul(pos == std::string::npos ? line : line.substr(pos + 1)) + 1;
+			}
+			return res;
+		}();
+		return n;
+	}
+
+	inline void interleave(void* p, const size_t bytes)
+	{
+#ifdef SYS_mbind
+		const size_t nodes = n_numa_nodes();
+		if(nodes < 2){
+			return;
+		}
+		static constexpr int mpol_interleave = 3;
+		std::vector<unsigned long> mask((nodes + 8*sizeof(unsigned long) - 1)/(8*sizeof(unsigned long)), 0);
+		for(size_t n = 0; n < nodes; n++){
+			mask[n/(8*sizeof(unsigned long))] |= 1UL << (n % (8*sizeof(unsigned long)));
+		}
+		syscall(SYS_mbind, p, bytes, mpol_interleave, mask.data(), nodes + 1, 0);
+#else
+		(void) p;
+		(void) bytes;
+#endif
+	}
+
+	// Touch the first byte of every page of size step. In parallel each page
+	// is touched only by the thread whose share of the elements contains its
+	// first byte, so 2 MB pages are not raced for by the threads sharing them.
+	inline void touch(char* p, const size_t bytes, const size_t element_size, const size_t step, const bool parallel)
+	{
+		if(!parallel){
+			for(size_t offset = 0; offset < bytes; offset += step){
+				p[offset] = 0;
+			}
+			return;
+		}
+		const size_t n = bytes/element_size;
+		#pragma omp parallel
+		{
+			size_t n_threads = 1, thread = 0;
+#ifdef _OPENMP
+			n_threads = static_cast<size_t>(omp_get_num_threads());
+			thread = static_cast<size_t>(omp_get_thread_num());
+#endif
+			const size_t begin = thread*n/n_threads*element_size;
+			const size_t end = thread + 1 == n_threads ? bytes : (thread + 1)*n/n_threads*element_size;
+			for(size_t offset = (begin + step - 1)/step*step; offset < end; offset += step){
+				p[offset] = 0;
+			}
+		}
+	}
+
+	// Large allocations are rounded up to whole huge pages, so that they can be
+	// unmapped without knowing how they were backed
+	inline size_t mapped_bytes(const size_t bytes)
+	{
+		return (bytes + huge_page - 1)/huge_page*huge_page;
+	}
+
+	inline void* allocate(const size_t bytes, const size_t element_size)
+	{
+		if(bytes < mmap_threshold){
+			void* p = ::operator new(bytes);
+			std::memset(p, 0, bytes);
+			return p;
+		}
+		const Memory_policy_t& policy = memory_policy();
+		const size_t len = mapped_bytes(bytes);
+		void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if(policy.pages == Page_size::Explicit_huge){
+			p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		}
+#endif
+		if(p == MAP_FAILED){
+			// No reserved huge pages left, fall back to transparent ones
+			p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if(p == MAP_FAILED){
+				throw std::bad_alloc();
+			}
+#ifdef MADV_HUGEPAGE
+			if(policy.pages != Page_size::Default){
+				madvise(p, len, MADV_HUGEPAGE);
+			}
+#endif
+		}
+		if(policy.placement == Placement::Interleaved){
+			interleave(p, len);
+		}
+		const long page = sysconf(_SC_PAGESIZE);
+		const size_t step = policy.pages != Page_size::Default ? huge_page : page > 0 ? static_cast<size_t>(page) : 4096;
+		touch(static_cast<char*>(p), bytes, element_size, step, policy.parallel_first_touch);
+		return p;
+	}
+
+	inline void deallocate(void* p, const size_t bytes)
+	{
+		if(bytes < mmap_threshold){
+			::operator delete(p);
+		}else{
+			munmap(p, mapped_bytes(bytes));
+		}
+	}
+}
+
+// Allocator for lattice sized arrays following memory_policy(). Memory comes
+// zeroed and elements are default initialised, so std::vector<T>(n) of
+// arithmetic T does not write the pages again from a single thread.
+template<class T>
+class Lattice_allocator_t{
+	public:
+		using value_type = T;
+
+		Lattice_allocator_t() = default;
+		template<class U>
+		Lattice_allocator_t(const Lattice_allocator_t<U>&) {}
+
+		T* allocate(const size_t n)
+		{
+			if(n > std::numeric_limits<size_t>::max()/sizeof(T)){
+				throw std::bad_alloc();
+			}
+			return static_cast<T*>(memory_detail::allocate(n*sizeof(T), sizeof(T)));
+		}
+
+		void deallocate(T* p, const size_t n){memory_detail::deallocate(p, n*sizeof(T));}
+
+		template<class U>
+		void construct(U* p){::new(static_cast<void*>(p)) U;}
+
+		template<class U, class... Args>
+		void construct(U* p, Args&&... args){::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);}
+
+		template<class U>
+		struct rebind{using other = Lattice_allocator_t<U>;};
+};
+
+template<class T, class U>
+bool operator==(const Lattice_allocator_t<T>&, const Lattice_allocator_t<U>&){return true;}
+template<class T, class U>
+bool operator!=(const Lattice_allocator_t<T>&, const Lattice_allocator_t<U>&){return false;}
+
+// Vectors of lattice arrays. Only freshly allocated elements are zero: after
+// shrinking or clear(), resize(n) within the capacity leaves the old values in
+// place, so use assign(n, 0) where zeros are needed.
+template<class T> using Lattice_vector = std::vector<T, Lattice_allocator_t<T>>;
+
+// Bind the OpenMP threads to the CPUs this process may run on. Compact puts
+// consecutive threads on consecutive CPUs, Spread spaces them out evenly, so
+// that both sockets get threads when there are fewer threads than CPUs.
+// Returns false if the affinity could not be set.
+inline bool pin_threads(const Thread_pinning pinning)
+{
+	if(pinning == Thread_pinning::None){
+		return true;
+	}
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+		return false;
+	}
+	std::vector<size_t> cpus;
+	for(size_t c = 0; c < static_cast<size_t>(CPU_SETSIZE); c++){
+		if(CPU_ISSET(c, &allowed)){
+			cpus.push_back(c);
+		}
+	}
+	if(cpus.empty()){
+		return false;
+	}
+	bool ok = true;
+	#pragma omp parallel reduction(&&:ok)
+	{
+		size_t thread = 0, n_threads = 1;
+#ifdef _OPENMP
+		thread = static_cast<size_t>(omp_get_thread_num());
+		n_threads = static_cast<size_t>(omp_get_num_threads());
+#endif
+		size_t k = thread % cpus.size();
+		if(pinning == Thread_pinning::Spread && n_threads < cpus.size()){
+			k = thread*cpus.size()/n_threads;
+		}
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpus[k], &set);
+		ok = sched_setaffinity(0, sizeof(set), &set) == 0;
+	}
+	return ok;
+}
+
+#endif // MEMORY_H
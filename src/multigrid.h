@@ -0,0 +1,221 @@
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <random>
+#include <cmath>
+#include <stdexcept>
+#include "potts.h"
+
+// Hierarchy of block spin lattices for equilibrating a Potts model. Level 0
+// is the fine model, level l + 1 has one site per block of block^dim sites of
+// level l, whose spin is the majority state of the block (ties broken at
+// random). Coarse levels couple with the fine couplings times coupling_scale
+// and feel the field times the block volume. After equilibrating a coarse
+// level, its changes are prolonged to the finer level by swapping, in every
+// block, the old and new block states, which keeps the structure inside the
+// blocks. The coarse models are kept, so the hierarchy can be reused for
+// several temperatures.
+template<size_t dim, size_t q>
+class Multigrid_t{
+	public:
+		using Potts = Potts_t<dim, q>;
+		using spin_type = typename Potts::spin_type;
+	private:
+		Potts& fine_m;
+		size_t block_m, block_volume_m;
+		double coupling_scale_m;
+		std::vector<std::unique_ptr<Potts>> coarse_m;
+		// blocks_m[l][c*block_volume_m + k], storage indices on level l of the
+		// sites in the block of site c of level l + 1
+		std::vector<std::vector<uint32_t>> blocks_m;
+		// Block spins of level l + 1 after the last restriction
+		std::vector<std::vector<spin_type>> restricted_m;
+		std::vector<double> J_m;
+		std::mt19937_64 gen_m;
+
+		void setup_blocks(const size_t l, const std::array<size_t, dim>& fine_size, const std::array<size_t, dim>& coarse_size)
+		{
+			const Site_order_t<dim>& fine_order = level(l).order();
+			const Site_order_t<dim>& coarse_order = level(l + 1).order();
+			const size_t n_coarse = level(l + 1).field().size();
+			blocks_m[l].resize(n_coarse*block_volume_m);
+			for(size_t c = 0; c < n_coarse; c++){
+				// Row major coordinates of the coarse site
+				std::array<size_t, dim> cc;
+				size_t tmp = coarse_order.row_major_index(c);
+				for(size_t i = 0; i < dim; i++){
+					cc[i] = tmp % coarse_size[i];
+					tmp /= coarse_size[i];
+				}
+				for(size_t k = 0; k < block_volume_m; k++){
+					size_t inner = k, index = 0, stride = 1;
+					for(size_t i = 0; i < dim; i++){
+						index += (cc[i]*block_m + inner % block_m)*stride;
+						inner /= block_m;
+						stride *= fine_size[i];
+					}
+					blocks_m[l][c*block_volume_m + k] = static_cast<uint32_t>(fine_order.storage_index(index));
+				}
+			}
+		}
+
+		// Majority rule block spins of level l on level l + 1
+		void restrict_level(const size_t l)
+		{
+			const Potts& fine = level(l);
+			Potts& coarse = level(l + 1);
+			const size_t n_coarse = coarse.field().size();
+			std::vector<spin_type> states(block_volume_m);
+			std::vector<size_t> counts(block_volume_m);
+			restricted_m[l].resize(n_coarse);
+			for(size_t c = 0; c < n_coarse; c++){
+				size_t n_states = 0;
+				for(size_t k = 0; k < block_volume_m; k++){
+					const spin_type s = fine.field().get(blocks_m[l][c*block_volume_m + k]);
+					size_t j = 0;
+					while(j < n_states && states[j] != s){
+						j++;
+					}
+					if(j == n_states){
+						states[n_states] = s;
+						counts[n_states++] = 0;
+					}
+					counts[j]++;
+				}
+				size_t best = 0, ties = 1;
+				for(size_t j = 1; j < n_states; j++){
+					if(counts[j] > counts[best]){
+						best = j;
+						ties = 1;
+					}else if(counts[j] == counts[best] && std::uniform_int_distribution<size_t>(0, ties++)(gen_m) == 0){
+						best = j;
+					}
+				}
+				restricted_m[l][c] = states[best];
+				coarse.set_spin(c, states[best]);
+			}
+		}
+
+		// Carry the changes of the block spins of level l + 1 since the last
+		// restriction over to level l
+		void prolong_level(const size_t l)
+		{
+			Potts& fine = level(l);
+			const Potts& coarse = level(l + 1);
+			for(size_t c = 0; c < coarse.field().size(); c++){
+				const spin_type old_spin = restricted_m[l][c], new_spin = coarse.field().get(c);
+				if(old_spin == new_spin){
+					continue;
+				}
+				for(size_t k = 0; k < block_volume_m; k++){
+					const size_t i = blocks_m[l][c*block_volume_m + k];
+					const spin_type s = fine.field().get(i);
+					if(s == old_spin){
+						fine.set_spin(i, new_spin);
+					}else if(s == new_spin){
+						fine.set_spin(i, old_spin);
+					}
+				}
+			}
+		}
+
+		// Couplings, temperature and field of the coarse levels from the fine model
+		void update_parameters()
+		{
+			std::vector<double> J = fine_m.J();
+			for(auto& val : J){
+				val *= coupling_scale_m;
+			}
+			double H = fine_m.H();
+			for(auto& coarse : coarse_m){
+				// Setting the couplings may recompute the neighbour shells
+				if(J != J_m){
+					coarse->set_interaction_parameters(J);
+				}
+				H *= static_cast<double>(block_volume_m);
+				coarse->set_H(H);
+				coarse->set_beta(fine_m.beta());
+			}
+			J_m = J;
+		}
+
+	public:
+		// n_levels coarse levels below fine, each lattice extent must be
+		// divisible by block^n_levels. The coarse lattices are built from the
+		// crystal of fine, so fine may not be a model sharing a neighbour table
+		// without one.
+		Multigrid_t(Potts& fine, const size_t n_levels, const size_t block = 2, const double coupling_scale = 1, const uint64_t seed = std::random_device()())
+		 : fine_m(fine), block_m(block), block_volume_m(1), coupling_scale_m(coupling_scale), coarse_m(),
+		 blocks_m(n_levels), restricted_m(n_levels), J_m(), gen_m(seed)
+		{
+			if(block_m < 2){
+				throw std::invalid_argument("Blocks need at least two sites per axis");
+			}
+			if(fine.crystal().lat().scale() == 0){
+				throw std::invalid_argument("Multigrid needs a model with a crystal, not only a shared neighbour table");
+			}
+			for(size_t i = 0; i < dim; i++){
+				block_volume_m *= block_m;
+			}
+			std::array<size_t, dim> size = fine.size();
+			// The lattice vectors span the whole box, so they shrink with it
+			GSL::Matrix lattice = fine.crystal().lat().lat();
+			for(size_t l = 0; l < n_levels; l++){
+				std::array<size_t, dim> coarse_size;
+				for(size_t i = 0; i < dim; i++){
+					if(size[i] % block_m != 0 || size[i]/block_m < 2){
+						throw std::invalid_argument("Lattice size not divisible into blocks");
+					}
+					coarse_size[i] = size[i]/block_m;
+				}
+				lattice = 1./static_cast<double>(block_m)*lattice;
+				coarse_m.emplace_back(new Potts(Lattice_t<dim>(lattice), coarse_size, fine.crystal().periodic(), fine.order().ordering(), fine.order().block()));
+				setup_blocks(l, size, coarse_size);
+				size = coarse_size;
+			}
+			update_parameters();
+		}
+
+		size_t n_levels() const {return coarse_m.size();}
+		size_t block() const {return block_m;}
+		double coupling_scale() const {return coupling_scale_m;}
+		void set_coupling_scale(const double scale){coupling_scale_m = scale; J_m.clear();}
+
+		// Level 0 is the fine model
+		Potts& level(const size_t l){return l == 0 ? fine_m : *coarse_m[l - 1];}
+		const Potts& level(const size_t l) const {return l == 0 ? fine_m : *coarse_m[l - 1];}
+
+		// Restrict the fine configuration to all coarse levels
+		void restrict_all()
+		{
+			for(size_t l = 0; l < coarse_m.size(); l++){
+				restrict_level(l);
+			}
+		}
+
+		// Restrict down to the coarsest level, run coarse_sweeps sweeps there,
+		// then prolong level by level, running fine_sweeps sweeps on every finer
+		// level including the fine model. Uses the current beta, H and couplings
+		// of the fine model.
+		void equilibrate(const size_t coarse_sweeps, const size_t fine_sweeps, const Sweep_options_t& options = Sweep_options_t())
+		{
+			Sweep_options_t sweep_options = options;
+			sweep_options.measure_every = 0;
+			update_parameters();
+			restrict_all();
+			if(coarse_m.empty()){
+				fine_m.sweep(fine_sweeps, sweep_options);
+				return;
+			}
+			coarse_m.back()->sweep(coarse_sweeps, sweep_options);
+			for(size_t l = coarse_m.size(); l > 0; l--){
+				prolong_level(l - 1);
+				level(l - 1).sweep(fine_sweeps, sweep_options);
+			}
+		}
+};
+
+#endif // MULTIGRID_H
@@ -0,0 +1,87 @@
+#ifndef NEIGHBOUR_TABLE_H
+#define NEIGHBOUR_TABLE_H
+
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <limits>
+#include "crystal.h"
+#include "site_order.h"
+#include "memory.h"
+
+// Flat neighbour lists in storage order. The neighbours of site s in shell k
+// are the indices in [begin(s, k), end(s, k)), all given as storage indices.
+template<size_t dim>
+class Neighbour_table_t{
+	public:
+		using index_type = uint32_t;
+	private:
+		size_t n_sites_m, n_shells_m;
+		Lattice_vector<size_t> offsets_m;
+		Lattice_vector<index_type> indices_m;
+		std::vector<double> radius_m;
+	public:
+		Neighbour_table_t() : n_sites_m(0), n_shells_m(0), offsets_m(1, 0), indices_m(), radius_m() {}
+		Neighbour_table_t(const std::vector<std::vector<Neighbours<dim>>>& nn_shells, const Site_order_t<dim>& order)
+		 : n_sites_m(nn_shells.size()), n_shells_m(0), offsets_m(), indices_m(), radius_m()
+		{
+			if(n_sites_m > std::numeric_limits<index_type>::max()){
+				throw std::length_error("Too many sites for 32 bit neighbour indices");
+			}
+			for(const auto& shells : nn_shells){
+				n_shells_m = std::max(n_shells_m, shells.size());
+			}
+			radius_m.assign(n_shells_m, 0);
+			offsets_m.reserve(n_sites_m*n_shells_m + 1);
+			offsets_m.push_back(0);
+			for(size_t s = 0; s < n_sites_m; s++){
+				const auto& shells = nn_shells[order.row_major_index(s)];
+				for(size_t k = 0; k < n_shells_m; k++){
+					if(k < shells.size()){
+						for(const auto& neighbour : shells[k]){
+							indices_m.push_back(static_cast<index_type>(order.storage_index(neighbour.index())));
+						}
+						if(radius_m[k] == 0 && shells[k].size() > 0){
+							radius_m[k] = shells[k][0].pos(). template norm<double>();
+						}
+					}
+					offsets_m.push_back(indices_m.size());
+				}
+			}
+		}
+
+		size_t n_sites() const {return n_sites_m;}
+		size_t n_shells() const {return n_shells_m;}
+		double radius(const size_t shell) const {return radius_m[shell];}
+
+		const index_type* begin(const size_t site, const size_t shell) const
+		{
+			return indices_m.data() + offsets_m[site*n_shells_m + shell];
+		}
+
+		const index_type* end(const size_t site, const size_t shell) const
+		{
+			return indices_m.data() + offsets_m[site*n_shells_m + shell + 1];
+		}
+
+		// Position of the first neighbour of site in shell in the flat index
+		// array, arrays laid out alongside the table use the same offsets
+		size_t offset(const size_t site, const size_t shell) const
+		{
+			return offsets_m[site*n_shells_m + shell];
+		}
+
+		size_t n_entries() const {return indices_m.size();}
+
+		size_t n_neighbours(const size_t site, const size_t shell) const
+		{
+			return offsets_m[site*n_shells_m + shell + 1] - offsets_m[site*n_shells_m + shell];
+		}
+
+		size_t bytes() const
+		{
+			return offsets_m.size()*sizeof(size_t) + indices_m.size()*sizeof(index_type) + radius_m.size()*sizeof(double);
+		}
+};
+
+#endif // NEIGHBOUR_TABLE_H
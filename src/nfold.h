@@ -0,0 +1,279 @@
+#ifndef NFOLD_H
+#define NFOLD_H
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <limits>
+#include "potts.h"
+#include "fenwick.h"
+#include "splitmix.h"
+
+// Rejection free n-fold way (Bortz, Kalos and Lebowitz) dynamics for a
+// Potts_t. Every site moves to each of its q - 1 other states with the
+// Metropolis rate min(1, exp(-beta dE))/(q - 1), time is measured in Monte
+// Carlo sweeps. Sites are grouped in classes sharing the same multiset of
+// energy changes, a Fenwick tree over the total rate of each class picks the
+// next class to move.
+template<size_t dim, size_t q>
+class Nfold_t{
+	public:
+		using Potts = Potts_t<dim, q>;
+		using spin_type = typename Potts::spin_type;
+		using Signature = std::array<int64_t, q - 1>;
+	private:
+		struct Signature_hasher{
+			size_t operator()(const Signature& sig) const
+			{
+				uint64_t res = 0;
+				for(auto val : sig){
+					res = splitmix64(res ^ static_cast<uint64_t>(val));
+				}
+				return res;
+			}
+		};
+
+		struct Site_class{
+			Signature signature;
+			double rate;
+			std::vector<size_t> members;
+		};
+
+		// Resolution used when comparing energy changes
+		static constexpr double energy_quantum = 1./(1 << 24);
+
+		Potts& potts_m;
+		std::vector<Site_class> classes_m;
+		std::unordered_map<Signature, size_t, Signature_hasher> class_index_m;
+		std::vector<size_t> class_of_m, position_m;
+		Fenwick_t rates_m;
+		std::mt19937_64 gen_m;
+		double time_m;
+		size_t n_steps_m;
+
+		std::array<double, q> local_field(const size_t index) const
+		{
+			std::array<double, q> res;
+			res.fill(0);
+			const auto& field = potts_m.field();
+			potts_m.for_each_coupled_neighbour(index, [&](const size_t n, const double J){
+				res[field.get(n)] += J;
+			});
+			return res;
+		}
+
+		// Energy changes for moving the spin at index to every other state,
+		// in order of the target state
+		std::array<double, q - 1> energy_changes(const size_t index) const
+		{
+			const std::array<double, q> field = local_field(index);
+			const spin_type spin = potts_m.field().get(index);
+			const double H = potts_m.H();
+			std::array<double, q - 1> res;
+			for(size_t t = 0, k = 0; t < q; t++){
+				if(t == spin){
+					continue;
+				}
+				res[k++] = field[spin] - field[t] + H*((spin == 0) - (t == 0));
+			}
+			return res;
+		}
+
+		double move_rate(const double delta_e) const
+		{
+			return (delta_e <= 0 ? 1. : std::exp(-potts_m.beta()*delta_e))/static_cast<double>(q - 1);
+		}
+
+		Signature signature(const size_t index) const
+		{
+			const std::array<double, q - 1> delta_e = energy_changes(index);
+			Signature res;
+			for(size_t k = 0; k < q - 1; k++){
+				res[k] = std::llround(delta_e[k]/energy_quantum);
+			}
+			std::sort(res.begin(), res.end());
+			return res;
+		}
+
+		double class_rate(const Signature& sig) const
+		{
+			double res = 0;
+			for(auto val : sig){
+				res += move_rate(static_cast<double>(val)*energy_quantum);
+			}
+			return res;
+		}
+
+		size_t find_class(const Signature& sig)
+		{
+			auto it = class_index_m.find(sig);
+			if(it != class_index_m.end()){
+				return it->second;
+			}
+			size_t c = classes_m.size();
+			classes_m.push_back(Site_class{sig, class_rate(sig), std::vector<size_t>()});
+			class_index_m[sig] = c;
+			if(c >= rates_m.size()){
+				rates_m.resize(std::max(size_t(16), 2*rates_m.size()));
+			}
+			return c;
+		}
+
+		void insert(const size_t index, const size_t c)
+		{
+			class_of_m[index] = c;
+			position_m[index] = classes_m[c].members.size();
+			classes_m[c].members.push_back(index);
+			rates_m.add(c, classes_m[c].rate);
+		}
+
+		void remove(const size_t index)
+		{
+			Site_class& cl = classes_m[class_of_m[index]];
+			const size_t last = cl.members.back();
+			cl.members[position_m[index]] = last;
+			position_m[last] = position_m[index];
+			cl.members.pop_back();
+			rates_m.add(class_of_m[index], -cl.rate);
+		}
+
+		void reclassify(const size_t index)
+		{
+			const size_t c = find_class(signature(index));
+			if(c != class_of_m[index]){
+				remove(index);
+				insert(index, c);
+			}
+		}
+
+		void rebuild_rates()
+		{
+			for(size_t c = 0; c < classes_m.size(); c++){
+				classes_m[c].rate = class_rate(classes_m[c].signature);
+				rates_m.set(c, classes_m[c].rate*static_cast<double>(classes_m[c].members.size()));
+			}
+			rates_m.rebuild();
+		}
+
+		double step_until(const double stop)
+		{
+			const double total = rates_m.total();
+			if(total <= 0){
+				time_m = std::isinf(stop) ? time_m : stop;
+				return std::numeric_limits<double>::infinity();
+			}
+			std::uniform_real_distribution<double> dist(0., 1.);
+			const double dt = -std::log(1. - dist(gen_m))/total;
+			if(time_m + dt > stop){
+				time_m = stop;
+				return dt;
+			}
+			size_t c = rates_m.find(dist(gen_m)*total);
+			// Round off since the last rebuild may land on an empty class, fall
+			// back to the heaviest one
+			if(classes_m[c].members.empty() || classes_m[c].rate <= 0){
+				double best = 0;
+				for(size_t k = 0; k < classes_m.size(); k++){
+					if(rates_m.get(k) > best){
+						best = rates_m.get(k);
+						c = k;
+					}
+				}
+			}
+			const auto& members = classes_m[c].members;
+			std::uniform_int_distribution<size_t> dist_i(0, members.size() - 1);
+			const size_t index = members[dist_i(gen_m)];
+
+			potts_m.set_spin(index, static_cast<spin_type>(pick_target(index)));
+
+			reclassify(index);
+			potts_m.for_each_coupled_neighbour(index, [this](const size_t n, const double){
+				reclassify(n);
+			});
+
+			n_steps_m++;
+			// The class weights are updated by adding and subtracting rates,
+			// reset them from the class sizes before round off builds up
+			if(n_steps_m % potts_m.field().size() == 0){
+				rebuild_rates();
+			}
+			time_m += dt;
+			return dt;
+		}
+
+		size_t pick_target(const size_t index)
+		{
+			const std::array<double, q - 1> delta_e = energy_changes(index);
+			std::array<double, q - 1> cumulative;
+			double sum = 0;
+			for(size_t k = 0; k < q - 1; k++){
+				sum += move_rate(delta_e[k]);
+				cumulative[k] = sum;
+			}
+			std::uniform_real_distribution<double> dist(0., sum);
+			size_t k = static_cast<size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), dist(gen_m)) - cumulative.begin());
+			k = std::min(k, q - 2);
+			// Skip over the current state
+			return k < potts_m.field().get(index) ? k : k + 1;
+		}
+
+	public:
+		Nfold_t(Potts& potts, const uint64_t seed = std::random_device()())
+		 : potts_m(potts), classes_m(), class_index_m(), class_of_m(), position_m(),
+		 rates_m(), gen_m(seed), time_m(0), n_steps_m(0)
+		{
+			reset();
+		}
+
+		// Reclassify every site, needed if the Potts model has been changed
+		// other than through this object
+		void reset()
+		{
+			const size_t n_sites = potts_m.field().size();
+			classes_m.clear();
+			class_index_m.clear();
+			rates_m = Fenwick_t();
+			class_of_m.assign(n_sites, 0);
+			position_m.assign(n_sites, 0);
+			for(size_t i = 0; i < n_sites; i++){
+				insert(i, find_class(signature(i)));
+			}
+			rates_m.rebuild();
+		}
+
+		void set_beta(const double beta)
+		{
+			potts_m.set_beta(beta);
+			rebuild_rates();
+		}
+
+		double time() const {return time_m;}
+		size_t n_steps() const {return n_steps_m;}
+		size_t n_classes() const {return classes_m.size();}
+		double total_rate() const {return rates_m.total();}
+
+		// Perform one spin flip, returns the time increment. Returns infinity
+		// and leaves the configuration unchanged if no move has a non zero rate.
+		double step()
+		{
+			return step_until(std::numeric_limits<double>::infinity());
+		}
+
+		// Flip spins until the simulated time has advanced by t (in sweeps).
+		// The waiting time is memoryless, so the flip that would cross the end
+		// time is simply not performed.
+		void run(const double t)
+		{
+			const double stop = time_m + t;
+			while(time_m < stop){
+				step_until(stop);
+			}
+		}
+};
+
+template<size_t dim, size_t q> constexpr double Nfold_t<dim, q>::energy_quantum;
+
+#endif // NFOLD_H
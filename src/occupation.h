@@ -0,0 +1,61 @@
+#ifndef OCCUPATION_H
+#define OCCUPATION_H
+
+#include <unordered_map>
+#include <cstddef>
+
+// Number of sites in each spin state, only states that are present are
+// stored, so the memory scales with the number of occupied states and not
+// with q
+template<class T>
+class Occupation_t{
+	private:
+		std::unordered_map<T, size_t> counts_m;
+	public:
+		Occupation_t() : counts_m() {}
+
+		template<class Field>
+		explicit Occupation_t(const Field& field) : counts_m()
+		{
+			for(const auto spin : field){
+				counts_m[spin]++;
+			}
+		}
+
+		void move(const T from, const T to)
+		{
+			if(from == to){
+				return;
+			}
+			auto it = counts_m.find(from);
+			if(--(it->second) == 0){
+				counts_m.erase(it);
+			}
+			counts_m[to]++;
+		}
+
+		size_t count(const T state) const
+		{
+			auto it = counts_m.find(state);
+			return it == counts_m.end() ? 0 : it->second;
+		}
+
+		size_t n_occupied() const {return counts_m.size();}
+
+		// Most occupied state and the number of sites in it
+		std::pair<T, size_t> largest() const
+		{
+			std::pair<T, size_t> res(0, 0);
+			for(const auto& val : counts_m){
+				if(val.second > res.second){
+					res = val;
+				}
+			}
+			return res;
+		}
+
+		typename std::unordered_map<T, size_t>::const_iterator begin() const {return counts_m.begin();}
+		typename std::unordered_map<T, size_t>::const_iterator end() const {return counts_m.end();}
+};
+
+#endif // OCCUPATION_H
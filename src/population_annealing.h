@@ -0,0 +1,259 @@
+#ifndef POPULATION_ANNEALING_H
+#define POPULATION_ANNEALING_H
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "potts.h"
+#include "memory.h"
+#include "splitmix.h"
+
+// State of the population after an annealing step
+struct Population_step_t{
+	double beta;
+	// ln Z and the free energy per site -ln Z/(beta N)
+	double log_Z;
+	double free_energy;
+	// Population averages of the energy per site and of |M|^2
+	double energy;
+	double m2;
+	// Effective population size (sum w)^2/sum w^2 of the resampling weights,
+	// and R sum_f (n_f/R)^2 over the families descending from one initial
+	// replica, which grows when few families survive
+	double effective_size;
+	double rho_family;
+};
+
+// Population annealing (Hukushima and Iba, AIP Conf. Proc. 690, 200 (2003),
+// Machta, PRE 82, 026704 (2010)) of R replicas on the lattice of a Potts_t.
+// The population starts at beta = 0 from random configurations. Every step
+// to a new beta resamples the replicas with weights exp(-(beta' - beta) E),
+// keeping R fixed by systematic resampling, and then sweeps every replica at
+// the new beta. ln Z is accumulated from the mean weights, starting from
+// N ln q at beta = 0.
+//
+// Spins of all replicas live in two arenas of R slots in the storage format
+// of Potts_t::Field, resampling copies slots from one into the other, so no
+// memory is allocated after construction. Sweeps run on one worker Potts_t
+// per OpenMP thread, sharing the neighbour table and couplings of geometry,
+// into which the replica is copied. The random numbers of a replica in a step
+// only depend on the seed, the step and the slot, and the resampling is done
+// serially in slot order, so the results do not depend on the number of
+// threads.
+template<size_t dim, size_t q>
+class Population_annealing_t{
+	public:
+		using Potts = Potts_t<dim, q>;
+		using Field = typename Potts::Field;
+		using word_type = typename Field::word_type;
+	private:
+		size_t n_replicas_m, n_sites_m, n_words_m;
+		std::vector<std::unique_ptr<Potts>> workers_m;
+		Lattice_vector<word_type> arena_m, next_arena_m;
+		std::vector<double> energy_m, m2_m, weight_m;
+		std::vector<uint32_t> family_m, next_family_m, family_count_m;
+		std::vector<size_t> first_copy_m;
+		double beta_m, log_Z_m;
+		uint64_t seed_m;
+		size_t n_steps_m;
+		std::mt19937_64 gen_m;
+
+		static size_t thread_id()
+		{
+#ifdef _OPENMP
+			return static_cast<size_t>(omp_get_thread_num());
+#else
+			return 0;
+#endif
+		}
+
+		word_type* slot(const size_t r){return arena_m.data() + r*n_words_m;}
+		const word_type* slot(const size_t r) const {return arena_m.data() + r*n_words_m;}
+
+		void load(const size_t r, Potts& potts) const
+		{
+			std::copy(slot(r), slot(r) + n_words_m, potts.field().data());
+			potts.spins_changed();
+		}
+
+		// Sweep replica r on the worker of the calling thread and measure it
+		void sweep_replica(const size_t r, const size_t n_sweeps, const Sweep_options_t& options)
+		{
+			Potts& worker = *workers_m[thread_id()];
+			load(r, worker);
+			worker.seed(splitmix64(seed_m + n_steps_m*n_replicas_m + r));
+			worker.set_beta(beta_m);
+			worker.sweep(n_sweeps, options);
+			std::copy(worker.field().data(), worker.field().data() + n_words_m, slot(r));
+			const Observables_t obs = worker.observables();
+			energy_m[r] = obs.energy*static_cast<double>(n_sites_m);
+			m2_m[r] = obs.m2;
+		}
+
+		// Systematic resampling of the replicas with weights weight_m summing
+		// to total, replica r gets the slots [first_copy_m[r], first_copy_m[r + 1])
+		void resample(const double total)
+		{
+			std::uniform_real_distribution<double> dist_d(0., 1.);
+			const double u = dist_d(gen_m);
+			const double scale = static_cast<double>(n_replicas_m)/total;
+			double cumulative = 0;
+			first_copy_m[0] = 0;
+			for(size_t r = 0; r < n_replicas_m; r++){
+				cumulative += weight_m[r]*scale;
+				first_copy_m[r + 1] = std::min(n_replicas_m, static_cast<size_t>(std::floor(cumulative + u)));
+			}
+			first_copy_m[n_replicas_m] = n_replicas_m;
+
+			#pragma omp parallel for schedule(dynamic, 16)
+			for(size_t r = 0; r < n_replicas_m; r++){
+				for(size_t c = first_copy_m[r]; c < first_copy_m[r + 1]; c++){
+					std::copy(slot(r), slot(r) + n_words_m, next_arena_m.data() + c*n_words_m);
+					next_family_m[c] = family_m[r];
+				}
+			}
+			std::swap(arena_m, next_arena_m);
+			std::swap(family_m, next_family_m);
+		}
+
+		double rho_family()
+		{
+			std::fill(family_count_m.begin(), family_count_m.end(), 0);
+			for(const auto f : family_m){
+				family_count_m[f]++;
+			}
+			double res = 0;
+			for(const auto n : family_count_m){
+				res += static_cast<double>(n)*static_cast<double>(n);
+			}
+			return res/static_cast<double>(n_replicas_m);
+		}
+
+	public:
+		// n_replicas replicas of the lattice, couplings and field of geometry,
+		// whose neighbour table must already have the shells for its couplings
+		Population_annealing_t(const Potts& geometry, const size_t n_replicas, const uint64_t seed = std::random_device()())
+		 : n_replicas_m(n_replicas), n_sites_m(geometry.field().size()), n_words_m(geometry.field().n_words()), workers_m(),
+		 arena_m(), next_arena_m(), energy_m(n_replicas, 0), m2_m(n_replicas, 0), weight_m(n_replicas, 0),
+		 family_m(n_replicas), next_family_m(n_replicas), family_count_m(n_replicas, 0), first_copy_m(n_replicas + 1, 0),
+		 beta_m(0), log_Z_m(static_cast<double>(n_sites_m)*std::log(static_cast<double>(q))), seed_m(seed), n_steps_m(0), gen_m(seed)
+		{
+			if(n_replicas_m == 0){
+				throw std::invalid_argument("Population annealing needs at least one replica");
+			}
+			size_t n_threads = 1;
+#ifdef _OPENMP
+			n_threads = static_cast<size_t>(omp_get_max_threads());
+#endif
+			for(size_t t = 0; t < n_threads; t++){
+				workers_m.emplace_back(new Potts(geometry.size(), geometry.order(), geometry.neighbour_table(), seed + t));
+				workers_m.back()->set_interaction_parameters(geometry.J());
+				workers_m.back()->set_bond_couplings(geometry.bond_couplings());
+				workers_m.back()->set_H(geometry.H());
+			}
+			arena_m.resize(n_replicas_m*n_words_m);
+			next_arena_m.resize(n_replicas_m*n_words_m);
+
+			// Random configurations, the equilibrium at beta = 0
+			#pragma omp parallel for schedule(dynamic, 16)
+			for(size_t r = 0; r < n_replicas_m; r++){
+				Potts& worker = *workers_m[thread_id()];
+				std::mt19937_64 gen(splitmix64(seed_m + r));
+				std::uniform_int_distribution<unsigned int> dist(0, q - 1);
+				for(size_t i = 0; i < n_sites_m; i++){
+					worker.field().set(i, static_cast<typename Potts::spin_type>(dist(gen)));
+				}
+				worker.spins_changed();
+				std::copy(worker.field().data(), worker.field().data() + n_words_m, slot(r));
+				energy_m[r] = worker.total_energy();
+				m2_m[r] = worker.observables().m2;
+				family_m[r] = static_cast<uint32_t>(r);
+			}
+		}
+
+		size_t n_replicas() const {return n_replicas_m;}
+		size_t n_steps() const {return n_steps_m;}
+		double beta() const {return beta_m;}
+		double log_Z() const {return log_Z_m;}
+		const std::vector<double>& energies() const {return energy_m;}
+
+		// Copy replica r into potts, which must have the same lattice size
+		void copy_to(const size_t r, Potts& potts) const
+		{
+			if(potts.field().n_words() != n_words_m){
+				throw std::invalid_argument("Lattice size does not match the population");
+			}
+			load(r, potts);
+		}
+
+		// Resample the population to beta and run n_sweeps sweeps of every
+		// replica at beta. Measurement callbacks in options are not used.
+		Population_step_t step(const double beta, const size_t n_sweeps, const Sweep_options_t& options = Sweep_options_t())
+		{
+			Sweep_options_t sweep_options = options;
+			sweep_options.measure_every = 0;
+			const double delta_beta = beta - beta_m;
+
+			// Weights relative to the largest one, so the exponentials cannot overflow
+			double shift = -std::numeric_limits<double>::infinity();
+			for(const auto E : energy_m){
+				shift = std::max(shift, -delta_beta*E);
+			}
+			#pragma omp parallel for schedule(static)
+			for(size_t r = 0; r < n_replicas_m; r++){
+				weight_m[r] = std::exp(-delta_beta*energy_m[r] - shift);
+			}
+			double total = 0, total2 = 0;
+			for(const auto w : weight_m){
+				total += w;
+				total2 += w*w;
+			}
+			log_Z_m += shift + std::log(total/static_cast<double>(n_replicas_m));
+
+			Population_step_t res;
+			res.effective_size = total*total/total2;
+			resample(total);
+			beta_m = beta;
+			n_steps_m++;
+
+			#pragma omp parallel for schedule(dynamic)
+			for(size_t r = 0; r < n_replicas_m; r++){
+				sweep_replica(r, n_sweeps, sweep_options);
+			}
+
+			res.beta = beta_m;
+			res.log_Z = log_Z_m;
+			res.free_energy = beta_m != 0 ? -log_Z_m/(beta_m*static_cast<double>(n_sites_m)) : -std::numeric_limits<double>::infinity();
+			res.energy = 0;
+			res.m2 = 0;
+			for(size_t r = 0; r < n_replicas_m; r++){
+				res.energy += energy_m[r]/static_cast<double>(n_sites_m*n_replicas_m);
+				res.m2 += m2_m[r]/static_cast<double>(n_replicas_m);
+			}
+			res.rho_family = rho_family();
+			return res;
+		}
+
+		// Step through the betas of schedule, calling report after every step
+		void anneal(const std::vector<double>& schedule, const size_t n_sweeps, const Sweep_options_t& options = Sweep_options_t(),
+			const std::function<void(const Population_step_t&)>& report = nullptr)
+		{
+			for(const auto beta : schedule){
+				const Population_step_t res = step(beta, n_sweeps, options);
+				if(report){
+					report(res);
+				}
+			}
+		}
+};
+
+#endif // POPULATION_ANNEALING_H
@@ -1,34 +1,79 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
-#include "ising.h"
+#include <pybind11/functional.h>
+#include "potts_model.h"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
 
-template<size_t dim>
-void declare_ising(py::module& m, const std::string& dim_str)
-{
-	using Ising_class = Ising_t<dim>;
-	std::string Ising_string = "Ising_" + dim_str + "D";
-	py::class_<Ising_class>(m, Ising_string.c_str())
-		.def(py::init<>())
-		.def(py::init<Lattice_t<dim>, std::array<size_t, dim>, bool>(), "l"_a, "s"_a, "periodic"_a = false)
-		.def("set_Jij", &Ising_class::set_interaction_parameters)
-		.def("set_H", &Ising_class::set_H)
-		.def("set_beta", &Ising_class::set_beta)
-		.def("add_spin_correlator", (void (Ising_class::*)(const size_t, const double)) &Ising_class::add_spin_correlator)
-		.def("add_spin_correlator", (void (Ising_class::*)(const std::array<size_t, dim>&, const double)) &Ising_class::add_spin_correlator)
-		.def("update", &Ising_class::update, "cluster"_a = false)
-		.def("measure_spin_correlators", &Ising_class::measure_spin_correlators)
-		.def("total_energy", &Ising_class::total_energy)
-		.def("average_site_energy", &Ising_class::average_site_energy)
-		.def("magnetization", &Ising_class::magnetization)
-		.def_property_readonly("field", &Ising_class::field);
+// Python bindings of the type erased models in libpotts, dim and q are
+// chosen when constructing a model
+PYBIND11_MODULE(potts, m){
+	py::enum_<Move_type>(m, "Move_type")
+		.value("Metropolis", Move_type::Metropolis)
+		.value("Heat_bath", Move_type::Heat_bath)
+		.value("Cluster", Move_type::Cluster)
+		.value("Swendsen_Wang", Move_type::Swendsen_Wang);
 
-}
+	py::enum_<Visit_order>(m, "Visit_order")
+		.value("Random", Visit_order::Random)
+		.value("Sequential", Visit_order::Sequential)
+		.value("Permutation", Visit_order::Permutation);
+
+	py::enum_<Site_ordering>(m, "Site_ordering")
+		.value("Row_major", Site_ordering::Row_major)
+		.value("Morton", Site_ordering::Morton)
+		.value("Hilbert", Site_ordering::Hilbert);
+
+	py::class_<Observables_t>(m, "Observables")
+		.def_readonly("sweep", &Observables_t::sweep)
+		.def_readonly("energy", &Observables_t::energy)
+		.def_readonly("magnetization", &Observables_t::magnetization)
+		.def_readonly("m2", &Observables_t::m2)
+		.def_readonly("m4", &Observables_t::m4);
+
+	py::class_<Sweep_options_t>(m, "Sweep_options")
+		.def(py::init<>())
+		.def_readwrite("move", &Sweep_options_t::move)
+		.def_readwrite("order", &Sweep_options_t::order)
+		.def_readwrite("cluster_moves", &Sweep_options_t::cluster_moves)
+		.def_readwrite("improved_estimators", &Sweep_options_t::improved_estimators)
+		.def_readwrite("measure_every", &Sweep_options_t::measure_every)
+		.def_readwrite("measure", &Sweep_options_t::measure);
 
+	py::class_<Potts_model_t>(m, "Potts")
+		.def(py::init(&make_potts_model), "dim"_a, "q"_a, "size"_a, "periodic"_a = false,
+			"ordering"_a = Site_ordering::Row_major, "order_block"_a = 1)
+		.def_property_readonly("dim", &Potts_model_t::dimension)
+		.def_property_readonly("q", &Potts_model_t::n_states)
+		.def_property_readonly("size", &Potts_model_t::size)
+		.def_property_readonly("n_sites", &Potts_model_t::n_sites)
+		.def("seed", &Potts_model_t::seed)
+		.def("set_Jij", &Potts_model_t::set_interaction_parameters)
+		.def("set_H", &Potts_model_t::set_H)
+		.def("set_beta", &Potts_model_t::set_beta)
+		.def_property_readonly("J", &Potts_model_t::J)
+		.def_property_readonly("H", &Potts_model_t::H)
+		.def_property_readonly("beta", &Potts_model_t::beta)
+		.def("sweep", &Potts_model_t::sweep, "n_sweeps"_a = 1, "options"_a = Sweep_options_t())
+		.def("sweep", [](Potts_model_t& potts, const size_t n_sweeps, const bool cluster){
+			Sweep_options_t options;
+			options.move = cluster ? Move_type::Cluster : Move_type::Metropolis;
+			potts.sweep(n_sweeps, options);
+		}, "n_sweeps"_a, "cluster"_a)
+		.def_property_readonly("n_sweeps", &Potts_model_t::n_sweeps)
+		.def("observables", &Potts_model_t::observables)
+		.def("add_spin_correlator", &Potts_model_t::add_spin_correlator)
+		.def("average_spin_correlators", &Potts_model_t::average_spin_correlators)
+		.def("reset_spin_correlators", &Potts_model_t::reset_spin_correlators)
+		.def("measure_spin_correlators", &Potts_model_t::measure_spin_correlators)
+		.def("spin_correlation", &Potts_model_t::spin_correlation)
+		.def("total_energy", &Potts_model_t::total_energy)
+		.def("average_site_energy", &Potts_model_t::average_site_energy)
+		.def("magnetization", &Potts_model_t::magnetization)
+		.def("order_parameter", &Potts_model_t::order_parameter)
+		.def("load_snapshot", &Potts_model_t::load_snapshot)
+		.def_property_readonly("field", &Potts_model_t::snapshot);
 
-PYBIND11_MODULE(ising, m){
-	declare_ising<2>(m, "2");
-//	declare_ising<3>(m, "3");
+	m.def("instances", &potts_model_instances);
 }
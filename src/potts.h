@@ -1,10 +1,14 @@
 #ifndef POTTS_H
-#define POTTSG_H
+#define POTTS_H
 
 #include <vector>
-#include <tuple>
 #include <algorithm>
 #include <random>
+#include <numeric>
+#include <functional>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
 
 #include <iostream>
 #include <iomanip>
@@ -12,20 +16,53 @@
 #include "crystal.h"
 #include "site.h"
 #include "lattice.h"
+#include "spin_storage.h"
+#include "site_order.h"
+#include "neighbour_table.h"
+#include "occupation.h"
+#include "bond_couplings.h"
+#include "sweep.h"
 #include "GSLpp/matrix.h"
 
 template<size_t dim, size_t q>
 class Potts_t{
 	using Site = Site_t<dim>;
+	public:
+		using Field = Spin_storage_t<q>;
+		using spin_type = typename Field::value_type;
+		using Bonds = Bond_couplings_t<float>;
 	private:
 		std::array<size_t, dim> size_m;
 		Crystal_t<dim> cr_m;
-		std::vector<uint8_t> field_m;
-		std::vector<std::vector<Neighbours<dim>>> nn_shells_m;
+		Site_order_t<dim> order_m;
+		Field field_m;
+		std::shared_ptr<const Neighbour_table_t<dim>> nn_table_m;
 		std::vector<double> J_m;
+		std::vector<Disorder_t> disorder_m;
+		uint64_t disorder_seed_m;
+		std::shared_ptr<const Bonds> bonds_m;
 		double H_m;
 		double beta_m;
-		std::vector<std::tuple<size_t, size_t, GSL::Vector>> correlators_m;
+		// Spin correlators, pairs (i, j) of storage indices with the shell of j
+		// around i as distance bin, and the summed delta(s_i, s_j) per bin
+		std::vector<uint32_t> corr_i_m, corr_j_m, corr_bin_m;
+		size_t corr_average_bins_m;
+		std::vector<uint64_t> corr_pairs_m, corr_average_pairs_m;
+		std::vector<double> corr_delta_m;
+		size_t corr_measurements_m;
+		std::mt19937_64 gen_m;
+		size_t n_sweeps_m;
+		bool track_occupation_m;
+		Occupation_t<spin_type> occupation_m;
+		// Last Wolff cluster and membership flags, Swendsen-Wang cluster labels
+		std::vector<size_t> cluster_m;
+		std::vector<uint8_t> in_cluster_m;
+		std::vector<uint32_t> cluster_label_m;
+		// Move whose clusters describe the current configuration, Metropolis if
+		// none do, and the improved m2 and m4 from the last Swendsen-Wang move
+		Move_type cluster_move_m;
+		bool improved_m;
+		double cluster_m2_m, cluster_m4_m;
 
 		size_t calc_length() const
 		{
@@ -39,12 +76,10 @@ class Potts_t{
 		void setup_field()
 		{
 			size_t length = calc_length();
-			field_m = std::vector<uint8_t>(length);
-			std::random_device rd;
-			std::mt19937 gen(rd());
-			std::uniform_int_distribution<uint8_t> dist(0,q - 1);
-			for(auto& val : field_m){
-				val = static_cast<int8_t>(dist(gen));
+			field_m = Field(length);
+			std::uniform_int_distribution<unsigned int> dist(0,q - 1);
+			for(size_t i = 0; i < length; i++){
+				field_m.set(i, static_cast<spin_type>(dist(gen_m)));
 			}
 		}
 
@@ -79,7 +114,7 @@ class Potts_t{
 				for(size_t j = 0; j < i - 1; j++ ){
 					offset *= size_m[j];
 				}
-				res += coords[i]*offset;
+				res += coords[i - 1]*offset;
 			}
 			return res;
 
@@ -109,109 +144,325 @@ class Potts_t{
 		void setup_nearest_neighbour_shells(const size_t n_steps = 1)
 		{
 			std::vector<Neighbours<dim>> nn = cr_m.calc_nearest_neighbours(n_steps);
-			nn_shells_m = std::move(cr_m.determine_nn_shells(nn));
+			nn_table_m = std::make_shared<const Neighbour_table_t<dim>>(cr_m.determine_nn_shells(nn), order_m);
+			if(!disorder_m.empty()){
+				bonds_m = std::make_shared<const Bonds>(*nn_table_m, order_m, disorder_m, disorder_seed_m);
+			}
+		}
+
+		// Enough neighbour shells to include n_shells interaction shells
+		void require_shells(const size_t n_shells)
+		{
+			if(n_shells > 1 && cr_m.sites().empty()){
+				// Shared neighbour table, there is no crystal to extend it from
+				if(n_shells > nn_table_m->n_shells()){
+					throw std::invalid_argument("Shared neighbour table has too few shells");
+				}
+			}else if(n_shells > 1){
+				std::cout << "Recalculating nearest neighbours to enable inclusion of (at least) " << n_shells << " nearest neighbour shells\n";
+				setup_nearest_neighbour_shells(n_shells/2 + 1);
+			}
+		}
+
+		// Number of neighbour shells within r_max, the correlation functions
+		// get one bin per shell. Measurements so far are discarded, as they do
+		// not include the new pairs.
+		size_t correlator_bins(const double r_max)
+		{
+			size_t n_bins = 0;
+			while(n_bins < nn_table_m->n_shells() && nn_table_m->radius(n_bins) <= r_max + 1e-6){
+				n_bins++;
+			}
+			if(n_bins > corr_pairs_m.size()){
+				corr_pairs_m.resize(n_bins, 0);
+				corr_delta_m.resize(n_bins, 0);
+			}
+			reset_spin_correlators();
+			return n_bins;
 		}
 
 		// Delta function for the interactions
 		double site_energy(const size_t index) const
 		{
 			double energy = 0;
-			uint8_t other_spins = 0;
-			// Loop over all interaction constants provided
-			for(size_t i = 0; i < J_m.size(); i++){
-				for(const auto neighbour : nn_shells_m[index][i]){
-					if(field_m[neighbour.index()] == field_m[index]){
-						other_spins++;
-					}
+			const spin_type spin = field_m.get(index);
+			const Field& field = field_m;
+			for_each_coupled_neighbour(index, [&](const size_t n, const double J){
+				if(field.get(n) == spin){
+					energy -= J/2;
 				}
-				energy -= J_m[i]/2 * other_spins;
-				other_spins = 0;
-			}
+			});
 			// External field aligned with 0th spin state
-			if(field_m[index] == 0){
+			if(spin == 0){
 				energy -= H_m;
 			}
 
 			return energy;
 		}
 
-		uint8_t change_spin(const size_t index) const
+		void assign_spin(const size_t index, const spin_type spin)
 		{
-			std::random_device rd;
-			std::mt19937 gen(rd());
-			std::uniform_int_distribution<uint8_t> dist(0,q - 1);
-			uint8_t res = field_m[index];
-			while(res == field_m[index]){
-				res = dist(gen);
+			cluster_move_m = Move_type::Metropolis;
+			if(track_occupation_m){
+				occupation_m.move(field_m.get(index), spin);
 			}
-			return res;
+			field_m.set(index, spin);
+		}
+
+		// Uniformly chosen state different from the current one
+		spin_type change_spin(const size_t index)
+		{
+			std::uniform_int_distribution<size_t> dist(0,q - 2);
+			const spin_type old_spin = field_m.get(index);
+			size_t res = dist(gen_m);
+			return static_cast<spin_type>(res < old_spin ? res : res + 1);
 		}
 
 		void flip_single_spin(const size_t index)
 		{
 			std::uniform_real_distribution<double> dist_d(0., 1.);
-			std::random_device rd;
-			std::mt19937 gen(rd());
-			uint8_t old_spin = field_m[index];
-			double e_site = site_energy(index);
-			field_m[index] = change_spin(index);
-			double e_trial = site_energy(index);
+			spin_type new_spin = change_spin(index);
+			double delta_e = delta_energy(index, new_spin);
+
+			if( delta_e <= 0 || dist_d(gen_m) < GSL::exp(-beta_m*delta_e).val){
+				assign_spin(index, new_spin);
+			}
+		}
+
+		// Metropolis move with beta and the uniform distribution hoisted out of
+		// the sweep loop
+		void metropolis_step(const size_t index, const double beta, std::uniform_real_distribution<double>& dist_d)
+		{
+			const spin_type new_spin = change_spin(index);
+			const double delta_e = delta_energy(index, new_spin);
+			if(delta_e <= 0 || dist_d(gen_m) < std::exp(-beta*delta_e)){
+				assign_spin(index, new_spin);
+			}
+		}
+
+		// Heat bath move costing O(z) for any q. Only the states present among
+		// the neighbours (and state 0 if H != 0) get individual weights, all
+		// other states are non interacting and share one "fresh" weight.
+		void heat_bath_step(const size_t index, const double beta, std::uniform_real_distribution<double>& dist_d)
+		{
+			static constexpr size_t max_local = 64;
+			std::array<spin_type, max_local> states;
+			std::array<double, max_local> weights;
+			size_t n_states = 0, k;
+			spin_type spin;
+			if(H_m != 0){
+				states[0] = 0;
+				weights[0] = H_m;
+				n_states = 1;
+			}
+			// weights[k] is minus the energy of the site in state states[k]
+			bool overflow = false;
+			for_each_coupled_neighbour(index, [&](const size_t n, const double J){
+				const spin_type s = field_m.get(n);
+				size_t m;
+				for(m = 0; m < n_states && states[m] != s; m++){}
+				if(m == n_states){
+					if(n_states == max_local){
+						overflow = true;
+						return;
+					}
+					states[m] = s;
+					weights[m] = 0;
+					n_states++;
+				}
+				weights[m] += J;
+			});
+			if(overflow){
+				metropolis_step(index, beta, dist_d);
+				return;
+			}
+
+			double w_max = 0;
+			for(k = 0; k < n_states; k++){
+				w_max = std::max(w_max, beta*weights[k]);
+			}
+			double total = static_cast<double>(q - n_states)*std::exp(-w_max);
+			for(k = 0; k < n_states; k++){
+				weights[k] = std::exp(beta*weights[k] - w_max);
+				total += weights[k];
+			}
+
+			double u = dist_d(gen_m)*total;
+			for(k = 0; k < n_states; k++){
+				u -= weights[k];
+				if(u < 0){
+					assign_spin(index, states[k]);
+					return;
+				}
+			}
+			if(n_states == q){
+				assign_spin(index, states[n_states - 1]);
+				return;
+			}
+			// Fresh state, uniformly among the states not seen above
+			std::uniform_int_distribution<size_t> dist_s(0, q - 1);
+			do{
+				spin = static_cast<spin_type>(dist_s(gen_m));
+				for(k = 0; k < n_states && states[k] != spin; k++){}
+			}while(k < n_states);
+			assign_spin(index, spin);
+		}
 
-			if( e_trial > e_site && dist_d(gen) > GSL::exp(-beta_m*(e_trial - e_site)).val){
-				field_m[index] = old_spin;
+		void single_spin_step(const Move_type move, const size_t index, const double beta, std::uniform_real_distribution<double>& dist_d)
+		{
+			if(move == Move_type::Heat_bath){
+				heat_bath_step(index, beta, dist_d);
+			}else{
+				metropolis_step(index, beta, dist_d);
 			}
 		}
 
-		std::vector<size_t> build_cluster(const size_t index)
+		// Grow a Wolff cluster from index into cluster_m
+		void build_cluster(const size_t index)
 		{
-			std::vector<size_t> to_treat{index};
-			std::unordered_set<size_t> treated;
 			std::uniform_real_distribution<double> dist_d(0., 1.);
-			std::random_device rd;
-			std::mt19937 gen(rd());
-			double J;
-			size_t i;
-
-			while(to_treat.size() > 0){
-				i = to_treat.back();
-				to_treat.pop_back();
-				for(size_t n_shell = 0; n_shell < J_m.size(); n_shell++){
-					J = J_m[n_shell];
-					for(auto neighbour : nn_shells_m[i][n_shell]){
-						if(J > 0){
-							if(field_m[neighbour.index()] == field_m[i] && dist_d(gen) > GSL::exp(-beta_m*J).val && treated.find(neighbour.index()) == treated.end()){
-								to_treat.push_back(neighbour.index());
-							}
-						}else if(J < 0){
-							if(field_m[neighbour.index()] != field_m[i] && dist_d(gen) > GSL::exp(beta_m*J).val && treated.find(neighbour.index()) == treated.end()){
-								to_treat.push_back(neighbour.index());
-							}
+			if(in_cluster_m.size() != field_m.size()){
+				in_cluster_m.assign(field_m.size(), 0);
+			}
+			for(const auto i : cluster_m){
+				in_cluster_m[i] = 0;
+			}
+			cluster_m.assign(1, index);
+			in_cluster_m[index] = 1;
+
+			// Sites are marked when added, so every bond is only tested once
+			for(size_t k = 0; k < cluster_m.size(); k++){
+				const size_t i = cluster_m[k];
+				const spin_type spin = field_m.get(i);
+				for_each_coupled_neighbour(i, [&](const size_t n, const double J){
+					if(in_cluster_m[n]){
+						return;
+					}
+					if(J > 0){
+						if(field_m.get(n) == spin && dist_d(gen_m) > std::exp(-beta_m*J)){
+							in_cluster_m[n] = 1;
+							cluster_m.push_back(n);
+						}
+					}else if(J < 0){
+						if(field_m.get(n) != spin && dist_d(gen_m) > std::exp(beta_m*J)){
+							in_cluster_m[n] = 1;
+							cluster_m.push_back(n);
 						}
 					}
-					treated.insert(i);
+				});
+			}
+		}
+
+		size_t flip_spin_cluster(const size_t index)
+		{
+			build_cluster(index);
+			spin_type new_spin = change_spin(index);
+			for(size_t i : cluster_m){
+				assign_spin(i, new_spin);
+			}
+			cluster_move_m = Move_type::Cluster;
+			return cluster_m.size();
+		}
+
+		uint32_t find_root(uint32_t i)
+		{
+			while(cluster_label_m[i] != i){
+				cluster_label_m[i] = cluster_label_m[cluster_label_m[i]];
+				i = cluster_label_m[i];
+			}
+			return i;
+		}
+
+		// Swendsen-Wang move, every cluster gets a new state drawn from its
+		// weight in the external field. Sets cluster_m2_m and cluster_m4_m.
+		void swendsen_wang_step(const double beta, std::uniform_real_distribution<double>& dist_d)
+		{
+			const size_t length = field_m.size();
+			cluster_label_m.resize(length);
+			std::iota(cluster_label_m.begin(), cluster_label_m.end(), 0);
+			for(size_t i = 0; i < length; i++){
+				const spin_type spin = field_m.get(i);
+				for_each_coupled_neighbour(i, [&](const size_t n, const double J){
+					if(n > i && J > 0 && field_m.get(n) == spin && dist_d(gen_m) > std::exp(-beta*J)){
+						const uint32_t ri = find_root(static_cast<uint32_t>(i)), rn = find_root(static_cast<uint32_t>(n));
+						cluster_label_m[std::max(ri, rn)] = std::min(ri, rn);
+					}
+				});
+			}
+
+			// Roots come before the other sites of their cluster
+			std::vector<uint32_t> size(length, 0);
+			std::vector<spin_type> state(length);
+			std::uniform_int_distribution<size_t> dist_s(1, q - 1);
+			for(size_t i = 0; i < length; i++){
+				cluster_label_m[i] = cluster_label_m[cluster_label_m[i]];
+				size[cluster_label_m[i]]++;
+			}
+			double s2 = 0, s4 = 0;
+			for(size_t i = 0; i < length; i++){
+				if(size[i] == 0){
+					continue;
 				}
+				const double c = static_cast<double>(size[i])/static_cast<double>(length);
+				s2 += c*c;
+				s4 += c*c*c*c;
+				const double p0 = 1/(1 + static_cast<double>(q - 1)*std::exp(-beta*H_m*static_cast<double>(size[i])));
+				state[i] = dist_d(gen_m) < p0 ? 0 : static_cast<spin_type>(dist_s(gen_m));
 			}
-			std::vector<size_t> res(treated.size());
-			auto res_it = res.begin();
-			for(auto tmp_it = treated.begin(); tmp_it != treated.end(); tmp_it++, res_it++){
-				*res_it = *tmp_it;
+			for(size_t i = 0; i < length; i++){
+				assign_spin(i, state[cluster_label_m[i]]);
 			}
-			return res;
+			cluster_move_m = Move_type::Swendsen_Wang;
+			cluster_m2_m = s2;
+			cluster_m4_m = s2*s2 + 2./(q - 1)*(s2*s2 - s4);
 		}
 
-		void flip_spin_cluster(const size_t index)
+		bool ferromagnetic() const
 		{
-			auto cluster = build_cluster(index);
-			uint8_t new_spin = change_spin(index);
-			for(size_t i : cluster){
-				field_m[i] = new_spin;
+			if(bonds_m){
+				return std::all_of(bonds_m->data(), bonds_m->data() + bonds_m->size(), [](const float J){return J >= 0;});
 			}
+			return std::all_of(J_m.begin(), J_m.end(), [](const double J){return J >= 0;});
 		}
 
+		// |M|^2 of the spin configuration
+		double order_parameter_squared() const
+		{
+			const double n = static_cast<double>(field_m.size());
+			double rho2 = 0;
+			auto add = [&](const Occupation_t<spin_type>& occupation){
+				for(const auto& val : occupation){
+					rho2 += static_cast<double>(val.second)*static_cast<double>(val.second)/(n*n);
+				}
+			};
+			if(track_occupation_m){
+				add(occupation_m);
+			}else{
+				add(Occupation_t<spin_type>(field_m));
+			}
+			return (static_cast<double>(q)*rho2 - 1)/static_cast<double>(q - 1);
+		}
+
+		// Estimator of delta(s_i, s_j) from the last clusters, 1/q plus
+		// (q - 1)/q times the probability that i and j are connected
+		double improved_delta(const size_t i, const size_t j) const
+		{
+			double connected;
+			if(cluster_move_m == Move_type::Swendsen_Wang){
+				connected = cluster_label_m[i] == cluster_label_m[j];
+			}else{
+				connected = in_cluster_m[i] && in_cluster_m[j] ? static_cast<double>(field_m.size())/static_cast<double>(cluster_m.size()) : 0;
+			}
+			return 1./q + (q - 1.)/q*connected;
+		}
+
+		bool use_improved() const {return improved_m && cluster_move_m != Move_type::Metropolis && H_m == 0;}
+
 	public:
-		Potts_t() : size_m(), cr_m(), field_m(), nn_shells_m(), J_m(), H_m(0), beta_m(), correlators_m() {}
-		Potts_t(const Lattice_t<dim>& l, const std::array<size_t, dim> & s, bool periodic = false)
-			: size_m(s), cr_m(l), field_m(), nn_shells_m(), J_m(), H_m(0), beta_m(), correlators_m()
+		Potts_t() : size_m(), cr_m(), order_m(), field_m(), nn_table_m(std::make_shared<const Neighbour_table_t<dim>>()), J_m(), disorder_m(), disorder_seed_m(0), bonds_m(), H_m(0), beta_m(), corr_i_m(), corr_j_m(), corr_bin_m(), corr_average_bins_m(0), corr_pairs_m(), corr_average_pairs_m(), corr_delta_m(), corr_measurements_m(0), gen_m(std::random_device()()), n_sweeps_m(0), track_occupation_m(false), occupation_m(), cluster_m(), in_cluster_m(), cluster_label_m(), cluster_move_m(Move_type::Metropolis), improved_m(false), cluster_m2_m(0), cluster_m4_m(0) {}
+		Potts_t(const Lattice_t<dim>& l, const std::array<size_t, dim> & s, bool periodic = false,
+			const Site_ordering ordering = Site_ordering::Row_major, const size_t order_block = 1)
+			: size_m(s), cr_m(l), order_m(s, ordering, order_block), field_m(), nn_table_m(std::make_shared<const Neighbour_table_t<dim>>()), J_m(), disorder_m(), disorder_seed_m(0), bonds_m(), H_m(0), beta_m(), corr_i_m(), corr_j_m(), corr_bin_m(), corr_average_bins_m(0), corr_pairs_m(), corr_average_pairs_m(), corr_delta_m(), corr_measurements_m(0), gen_m(std::random_device()()), n_sweeps_m(0), track_occupation_m(false), occupation_m(), cluster_m(), in_cluster_m(), cluster_label_m(), cluster_move_m(Move_type::Metropolis), improved_m(false), cluster_m2_m(0), cluster_m4_m(0)
 		{
 			setup_field();
 			setup_crystal();
@@ -219,29 +470,93 @@ class Potts_t{
 			setup_crystal_lattice_vectors(periodic);
 			setup_nearest_neighbour_shells(1);
 		}
+		// Model sharing the neighbour table of models with the same lattice,
+		// size, periodicity and site ordering, see neighbour_table(). No crystal
+		// is set up, so the table must have all shells the couplings need.
+		Potts_t(const std::array<size_t, dim>& s, const Site_order_t<dim>& order, const std::shared_ptr<const Neighbour_table_t<dim>>& nn_table,
+			const uint64_t seed = std::random_device()())
+			: size_m(s), cr_m(), order_m(order), field_m(), nn_table_m(nn_table), J_m(), disorder_m(), disorder_seed_m(0), bonds_m(), H_m(0), beta_m(), corr_i_m(), corr_j_m(), corr_bin_m(), corr_average_bins_m(0), corr_pairs_m(), corr_average_pairs_m(), corr_delta_m(), corr_measurements_m(0), gen_m(seed), n_sweeps_m(0), track_occupation_m(false), occupation_m(), cluster_m(), in_cluster_m(), cluster_label_m(), cluster_move_m(Move_type::Metropolis), improved_m(false), cluster_m2_m(0), cluster_m4_m(0)
+		{
+			if(!nn_table_m || nn_table_m->n_sites() != calc_length()){
+				throw std::invalid_argument("Neighbour table does not match the lattice size");
+			}
+			setup_field();
+		}
 
 		void set_interaction_parameters(const std::vector<double>& J)
 		{
 			J_m = J;
-			if(J_m.size() > 1){
-				std::cout << "Recalculating nearest neighbours to enable inclusion of (at least) " << J_m.size() << " nearest neighbour shells\n";
-				setup_nearest_neighbour_shells(J_m.size()/2 + 1);
+			require_shells(J_m.size());
+		}
+
+		// Per bond random couplings, shell k drawn from disorder[k]. These
+		// replace the shell couplings set by set_interaction_parameters.
+		void set_disorder(const std::vector<Disorder_t>& disorder, const uint64_t seed)
+		{
+			disorder_m = disorder;
+			disorder_seed_m = seed;
+			if(disorder_m.size() > nn_table_m->n_shells()){
+				require_shells(disorder_m.size());
+			}else{
+				bonds_m = std::make_shared<const Bonds>(*nn_table_m, order_m, disorder_m, disorder_seed_m);
+			}
+		}
+
+		// Share the couplings of another replica with the same lattice
+		void set_bond_couplings(const std::shared_ptr<const Bonds>& bonds)
+		{
+			if(bonds && bonds->size() != nn_table_m->n_entries()){
+				throw std::invalid_argument("Bond couplings do not match the neighbour table");
 			}
+			bonds_m = bonds;
+			disorder_m.clear();
 		}
 
+		std::shared_ptr<const Bonds> bond_couplings() const {return bonds_m;}
+
+		// Calls f(neighbour, J) for every neighbour interacting with the site
+		// at (storage) index, J being the coupling of the bond
+		template<class F>
+		void for_each_coupled_neighbour(const size_t index, F f) const
+		{
+			::for_each_coupled_neighbour(*nn_table_m, bonds_m.get(), J_m, index, f);
+		}
+
+		void seed(const uint64_t s){gen_m.seed(s);}
 		void set_H(const double H){H_m = H;}
 		void set_beta(const double beta){beta_m = beta;}
 
+		const std::vector<double>& J() const {return J_m;}
+		double H() const {return H_m;}
+		double beta() const {return beta_m;}
+
+		// Change in total_energy() if the spin at (storage) index is set to new_spin
+		double delta_energy(const size_t index, const spin_type new_spin) const
+		{
+			const spin_type old_spin = field_m.get(index);
+			double res = 0;
+			const Field& field = field_m;
+			for_each_coupled_neighbour(index, [&](const size_t n, const double J){
+				const spin_type spin = field.get(n);
+				res += J*((spin == old_spin) - (spin == new_spin));
+			});
+			res += H_m*((old_spin == 0) - (new_spin == 0));
+			return res;
+		}
+
+		// Correlate the spin at (row major) index with all spins in the
+		// neighbour shells within r_max of it
 		void add_spin_correlator(const size_t index, const double r_max)
 		{
-			double r = 0;
-			size_t j = 0;
-			while(r <= r_max && j < nn_shells_m[index].size() && nn_shells_m[index][j].size() > 0){
-				r = nn_shells_m[index][j][0].pos(). template norm<double>();
-				for(const auto& site : nn_shells_m[index][j]){
-					correlators_m.push_back(std::make_tuple(index, site.index(), site.pos()));
+			const size_t i = order_m.storage_index(index);
+			const size_t n_bins = correlator_bins(r_max);
+			for(size_t shell = 0; shell < n_bins; shell++){
+				for(auto j = nn_table_m->begin(i, shell); j != nn_table_m->end(i, shell); j++){
+					corr_i_m.push_back(static_cast<uint32_t>(i));
+					corr_j_m.push_back(*j);
+					corr_bin_m.push_back(static_cast<uint32_t>(shell));
+					corr_pairs_m[shell]++;
 				}
-				j++;
 			}
 		}
 
@@ -250,23 +565,71 @@ class Potts_t{
 			add_spin_correlator(calc_index(i), r_max);
 		}
 
-		// void add_spin_correlator(const std::array<size_t, dim>& i, const std::array<size_t, dim>& j)
-		// {
-		// 	size_t i_index = 0;
-		// 	size_t j_index = 0;
-		//
-		// 	add_spin_correlator(i_index, j_index);
-		// }
+		// Correlate every spin with all spins within r_max of it, averaging the
+		// correlation functions over all translations of the origin
+		void average_spin_correlators(const double r_max)
+		{
+			const size_t n_bins = correlator_bins(r_max);
+			corr_average_pairs_m.resize(std::max(corr_average_pairs_m.size(), n_bins), 0);
+			for(size_t shell = corr_average_bins_m; shell < n_bins; shell++){
+				for(size_t i = 0; i < nn_table_m->n_sites(); i++){
+					corr_average_pairs_m[shell] += nn_table_m->n_neighbours(i, shell);
+				}
+				corr_pairs_m[shell] += corr_average_pairs_m[shell];
+			}
+			corr_average_bins_m = std::max(corr_average_bins_m, n_bins);
+		}
+
+		// Forget the measured correlations, keeping the correlated pairs
+		void reset_spin_correlators()
+		{
+			std::fill(corr_delta_m.begin(), corr_delta_m.end(), 0);
+			corr_measurements_m = 0;
+		}
 
-		std::vector<uint8_t>& field(){return field_m;}
+		// Spins in storage order, see order() for the mapping to row major indices
+		Field& field(){return field_m;}
+		const Field& field() const {return field_m;}
+		const Site_order_t<dim>& order() const {return order_m;}
+		const std::array<size_t, dim>& size() const {return size_m;}
+		const Crystal_t<dim>& crystal() const {return cr_m;}
+		const Neighbour_table_t<dim>& neighbours() const {return *nn_table_m;}
+		std::shared_ptr<const Neighbour_table_t<dim>> neighbour_table() const {return nn_table_m;}
+
+		// Unpacked copy of the spin configuration, one element per site in row major order
+		std::vector<spin_type> snapshot() const {return order_m.to_row_major(field_m.unpack());}
+		void load_snapshot(const std::vector<spin_type>& spins)
+		{
+			field_m.pack(order_m.to_storage(spins));
+			spins_changed();
+		}
+
+		// Change the spin at (storage) index, keeping the occupation counts
+		void set_spin(const size_t index, const spin_type spin){assign_spin(index, spin);}
+
+		// Call after writing spins directly through field(), brings the
+		// occupation counts and cluster bookkeeping up to date
+		void spins_changed()
+		{
+			cluster_move_m = Move_type::Metropolis;
+			if(track_occupation_m){
+				occupation_m = Occupation_t<spin_type>(field_m);
+			}
+		}
+
+		// Keep track of the number of sites in every occupied state
+		void track_occupation(const bool track = true)
+		{
+			track_occupation_m = track;
+			occupation_m = track ? Occupation_t<spin_type>(field_m) : Occupation_t<spin_type>();
+		}
+		const Occupation_t<spin_type>& occupation() const {return occupation_m;}
 
 		void update(bool cluster = false)
 		{
 			size_t length = calc_length();
-			std::random_device rd;
-			std::mt19937 gen(rd());
 			std::uniform_int_distribution<size_t> dist_i(0, length - 1);
-			size_t index = dist_i(gen);
+			size_t index = dist_i(gen_m);
 			if(cluster){
 				flip_spin_cluster(index);
 			}else{
@@ -274,33 +637,130 @@ class Potts_t{
 			}
 		}
 
+		// Run n_sweeps sweeps, a sweep being one attempted move per site or
+		// options.cluster_moves cluster moves
+		void sweep(const size_t n_sweeps, const Sweep_options_t& options = Sweep_options_t())
+		{
+			const size_t length = field_m.size();
+			const double beta = beta_m;
+			const bool measure = options.measure_every > 0 && options.measure;
+			std::uniform_int_distribution<size_t> dist_i(0, length - 1);
+			std::uniform_real_distribution<double> dist_d(0., 1.);
+			std::vector<size_t> permutation;
+			if(options.move == Move_type::Swendsen_Wang && !ferromagnetic()){
+				throw std::invalid_argument("Swendsen-Wang moves need non-negative couplings");
+			}
+			improved_m = options.improved_estimators;
+			if(options.move != Move_type::Cluster && options.order == Visit_order::Permutation){
+				permutation.resize(length);
+				std::iota(permutation.begin(), permutation.end(), 0);
+			}
+
+			for(size_t it = 0; it < n_sweeps; it++){
+				if(options.move == Move_type::Cluster){
+					for(size_t c = 0; c < options.cluster_moves; c++){
+						flip_spin_cluster(dist_i(gen_m));
+					}
+				}else if(options.move == Move_type::Swendsen_Wang){
+					swendsen_wang_step(beta, dist_d);
+				}else if(options.order == Visit_order::Sequential){
+					for(size_t i = 0; i < length; i++){
+						single_spin_step(options.move, i, beta, dist_d);
+					}
+				}else if(options.order == Visit_order::Permutation){
+					std::shuffle(permutation.begin(), permutation.end(), gen_m);
+					for(const auto i : permutation){
+						single_spin_step(options.move, i, beta, dist_d);
+					}
+				}else{
+					for(size_t i = 0; i < length; i++){
+						single_spin_step(options.move, dist_i(gen_m), beta, dist_d);
+					}
+				}
+				n_sweeps_m++;
+				if(measure && n_sweeps_m % options.measure_every == 0){
+					options.measure(observables());
+				}
+			}
+		}
+
+		size_t n_sweeps() const {return n_sweeps_m;}
+
+		Observables_t observables() const
+		{
+			double m2, m4;
+			if(use_improved() && cluster_move_m == Move_type::Swendsen_Wang){
+				m2 = cluster_m2_m;
+				m4 = cluster_m4_m;
+			}else{
+				m2 = order_parameter_squared();
+				m4 = m2*m2;
+			}
+			return Observables_t{n_sweeps_m, average_site_energy(), magnetization(), m2, m4};
+		}
+
 		int spin_spin(const size_t i, const size_t j) const
 		{
-			return field_m[i]*field_m[j];
+			return field_m.get(order_m.storage_index(i))*field_m.get(order_m.storage_index(j));
 		}
 
-		std::vector<std::tuple<double, double, double>> measure_spin_correlators()
+		// Add the current configuration to the correlation functions, using
+		// the cluster estimators if they are enabled and valid
+		void measure_spin_correlators()
 		{
-			std::vector<std::tuple<double, double, double>> res(correlators_m.size());
-			size_t i, j;
-			unsigned int si, ss, sj;
-			double r = 0;
-			std::tuple<size_t, size_t, GSL::Vector> corr;
-			for(auto index = 0; index < correlators_m.size(); index++){
-				corr = correlators_m[index];
-				i = std::get<0>(corr);
-				j = std::get<1>(corr);
-				si = field_m[i];
-				sj = field_m[j];
-				r = std::get<2>(corr).template norm<double>();
-				res[index] = std::make_tuple(r, si, sj);
+			const size_t n_pairs = corr_i_m.size();
+			const uint32_t* const ci = corr_i_m.data();
+			const uint32_t* const cj = corr_j_m.data();
+			const uint32_t* const bin = corr_bin_m.data();
+			const bool improved = use_improved();
+			for(size_t k = 0; k < n_pairs; k++){
+				corr_delta_m[bin[k]] += improved ? improved_delta(ci[k], cj[k]) : field_m.get(ci[k]) == field_m.get(cj[k]);
+			}
+			if(improved && cluster_move_m == Move_type::Cluster){
+				// Only pairs inside the Wolff cluster contribute beyond 1/q
+				for(size_t shell = 0; shell < corr_average_bins_m; shell++){
+					corr_delta_m[shell] += static_cast<double>(corr_average_pairs_m[shell])/q;
+				}
+				for(const auto i : cluster_m){
+					for(size_t shell = 0; shell < corr_average_bins_m; shell++){
+						for(auto j = nn_table_m->begin(i, shell); j != nn_table_m->end(i, shell); j++){
+							corr_delta_m[shell] += improved_delta(i, *j) - 1./q;
+						}
+					}
+				}
+			}else{
+				for(size_t i = 0; i < nn_table_m->n_sites(); i++){
+					const spin_type s = field_m.get(i);
+					for(size_t shell = 0; shell < corr_average_bins_m; shell++){
+						double delta = 0;
+						for(auto j = nn_table_m->begin(i, shell); j != nn_table_m->end(i, shell); j++){
+							delta += improved ? improved_delta(i, *j) : field_m.get(*j) == s;
+						}
+						corr_delta_m[shell] += delta;
+					}
+				}
+			}
+			corr_measurements_m++;
+		}
+
+		// Distance and average of delta(s_i, s_j) - 1/q over all measurements
+		// and pairs, for every distance bin
+		std::vector<std::pair<double, double>> spin_correlation() const
+		{
+			std::vector<std::pair<double, double>> res(corr_pairs_m.size());
+			for(size_t bin = 0; bin < res.size(); bin++){
+				const double n = static_cast<double>(corr_pairs_m[bin])*static_cast<double>(corr_measurements_m);
+				res[bin] = std::make_pair(nn_table_m->radius(bin), n > 0 ? corr_delta_m[bin]/n - 1./q : 0.);
 			}
 			return res;
 		}
 
+		size_t n_correlator_measurements() const {return corr_measurements_m;}
+
 		double total_energy() const
 		{
 			double res = 0;
+			#pragma omp parallel for reduction(+:res) schedule(static)
 			for(size_t i = 0; i < field_m.size(); i++){
 				res += site_energy(i);
 			}
@@ -316,11 +776,16 @@ class Potts_t{
 		double magnetization() const
 		{
 			double length = static_cast<double>(calc_length());
-			unsigned int tot_spin = 0;
-			for(auto spin : field_m){
-				tot_spin += spin;
-			}
-			return static_cast<double>(tot_spin)/length;
+			return static_cast<double>(field_m.sum())/length;
+		}
+
+		// Potts order parameter (q rho_max - 1)/(q - 1), rho_max being the
+		// fraction of sites in the most occupied state
+		double order_parameter() const
+		{
+			const size_t largest = track_occupation_m ? occupation_m.largest().second : Occupation_t<spin_type>(field_m).largest().second;
+			const double rho = static_cast<double>(largest)/static_cast<double>(calc_length());
+			return (static_cast<double>(q)*rho - 1)/static_cast<double>(q - 1);
 		}
 };
 
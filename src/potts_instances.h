@@ -0,0 +1,29 @@
+#ifndef POTTS_INSTANCES_H
+#define POTTS_INSTANCES_H
+
+#include "potts.h"
+
+// (dim, q) combinations compiled into libpotts. Translation units including
+// this header instead of potts.h use those instantiations instead of
+// compiling their own, and must be linked with libpotts.
+#define POTTS_DIMS(X) X(2) X(3) X(4)
+#define POTTS_INSTANCES(X) \
+	X(2, 2) X(2, 3) X(2, 4) X(2, 5) X(2, 6) X(2, 8) X(2, 10) \
+	X(3, 2) X(3, 3) X(3, 4) X(3, 5) X(3, 6) X(3, 8) X(3, 10) \
+	X(4, 2) X(4, 3) X(4, 4)
+
+#ifndef POTTS_INSTANTIATE
+#define POTTS_EXTERN_DIM(dim) \
+	extern template class Lattice_t<dim>; \
+	extern template class Site_t<dim>; \
+	extern template class Crystal_t<dim>; \
+	extern template class Site_order_t<dim>; \
+	extern template class Neighbour_table_t<dim>;
+#define POTTS_EXTERN(dim, q) extern template class Potts_t<dim, q>;
+POTTS_DIMS(POTTS_EXTERN_DIM)
+POTTS_INSTANCES(POTTS_EXTERN)
+#undef POTTS_EXTERN_DIM
+#undef POTTS_EXTERN
+#endif
+
+#endif // POTTS_INSTANCES_H
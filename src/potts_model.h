@@ -0,0 +1,59 @@
+#ifndef POTTS_MODEL_H
+#define POTTS_MODEL_H
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include "sweep.h"
+#include "site_order.h"
+
+// Potts model with dim and q chosen at run time. The implementations are
+// the Potts_t instantiations compiled into libpotts, see potts_instances.h,
+// so code using only this header does not compile any of the model itself.
+// Spins and indices follow Potts_t: snapshots are in row major order, and
+// correlator origins are row major indices, like snapshots.
+class Potts_model_t{
+	public:
+		virtual ~Potts_model_t() = default;
+
+		virtual size_t dimension() const = 0;
+		virtual size_t n_states() const = 0;
+		virtual std::vector<size_t> size() const = 0;
+		virtual size_t n_sites() const = 0;
+
+		virtual void seed(const uint64_t s) = 0;
+		virtual void set_interaction_parameters(const std::vector<double>& J) = 0;
+		virtual void set_H(const double H) = 0;
+		virtual void set_beta(const double beta) = 0;
+		virtual const std::vector<double>& J() const = 0;
+		virtual double H() const = 0;
+		virtual double beta() const = 0;
+
+		virtual void sweep(const size_t n_sweeps, const Sweep_options_t& options = Sweep_options_t()) = 0;
+		virtual size_t n_sweeps() const = 0;
+		virtual Observables_t observables() const = 0;
+		virtual double total_energy() const = 0;
+		virtual double average_site_energy() const = 0;
+		virtual double magnetization() const = 0;
+		virtual double order_parameter() const = 0;
+
+		virtual std::vector<uint32_t> snapshot() const = 0;
+		virtual void load_snapshot(const std::vector<uint32_t>& spins) = 0;
+
+		virtual void add_spin_correlator(const size_t index, const double r_max) = 0;
+		virtual void average_spin_correlators(const double r_max) = 0;
+		virtual void reset_spin_correlators() = 0;
+		virtual void measure_spin_correlators() = 0;
+		virtual std::vector<std::pair<double, double>> spin_correlation() const = 0;
+};
+
+// Model on a simple cubic lattice of the given size, throws
+// std::invalid_argument if (dim, q) is not in libpotts
+std::unique_ptr<Potts_model_t> make_potts_model(const size_t dim, const size_t q, const std::vector<size_t>& size,
+	const bool periodic = false, const Site_ordering ordering = Site_ordering::Row_major, const size_t order_block = 1);
+
+// The (dim, q) combinations make_potts_model supports
+std::vector<std::pair<size_t, size_t>> potts_model_instances();
+
+#endif // POTTS_MODEL_H
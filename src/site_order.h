@@ -0,0 +1,183 @@
+#ifndef SITE_ORDER_H
+#define SITE_ORDER_H
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <stdexcept>
+
+enum class Site_ordering{Row_major, Morton, Hilbert};
+
+// Maps between row major site indices (as used by Site_t and Crystal_t) and
+// the index a site is stored at. Curve orderings visit blocks of side block
+// along a Morton or Hilbert curve, sites inside a block in row major order.
+template<size_t dim>
+class Site_order_t{
+	private:
+		Site_ordering ordering_m;
+		std::array<size_t, dim> size_m;
+		size_t block_m;
+		std::vector<size_t> to_storage_m, to_row_major_m;
+
+		static size_t bits_needed(const size_t n)
+		{
+			size_t bits = 1;
+			while((size_t(1) << bits) < n){
+				bits++;
+			}
+			return bits;
+		}
+
+		static uint64_t interleave(const std::array<size_t, dim>& x, const size_t bits)
+		{
+			uint64_t res = 0;
+			for(size_t b = bits; b > 0; b--){
+				for(size_t i = dim; i > 0; i--){
+					res = (res << 1) | ((x[i - 1] >> (b - 1)) & 1);
+				}
+			}
+			return res;
+		}
+
+		std::array<size_t, dim> calc_coord(const size_t index) const
+		{
+			std::array<size_t, dim> res;
+			size_t tmp = index;
+			for(size_t i = 0; i < dim; i++){
+				res[i] = tmp % size_m[i];
+				tmp /= size_m[i];
+			}
+			return res;
+		}
+
+		void setup_permutation()
+		{
+			size_t length = 1, max_blocks = 1;
+			for(auto s : size_m){
+				length *= s;
+				max_blocks = std::max(max_blocks, (s + block_m - 1)/block_m);
+			}
+			const size_t bits = bits_needed(max_blocks);
+			if(bits*dim > 64){
+				throw std::length_error("Lattice too large for a 64 bit space filling curve key");
+			}
+
+			std::vector<std::pair<uint64_t, size_t>> keys(length);
+			std::array<size_t, dim> coord, block_coord;
+			for(size_t idx = 0; idx < length; idx++){
+				coord = calc_coord(idx);
+				size_t inner = 0, inner_offset = 1;
+				for(size_t i = 0; i < dim; i++){
+					block_coord[i] = coord[i] / block_m;
+					inner += (coord[i] % block_m)*inner_offset;
+					inner_offset *= block_m;
+				}
+				uint64_t key = ordering_m == Site_ordering::Hilbert ? hilbert_key(block_coord, bits) : morton_key(block_coord, bits);
+				// Inner offsets are below block^dim, so (key, inner) orders uniquely
+				keys[idx] = std::make_pair(key, inner);
+			}
+
+			to_row_major_m.resize(length);
+			std::iota(to_row_major_m.begin(), to_row_major_m.end(), 0);
+			std::sort(to_row_major_m.begin(), to_row_major_m.end(),
+				[&keys](const size_t a, const size_t b){return keys[a] < keys[b];});
+			to_storage_m.resize(length);
+			for(size_t s = 0; s < length; s++){
+				to_storage_m[to_row_major_m[s]] = s;
+			}
+		}
+
+	public:
+		Site_order_t() : ordering_m(Site_ordering::Row_major), size_m(), block_m(1), to_storage_m(), to_row_major_m() {}
+		Site_order_t(const std::array<size_t, dim>& size, const Site_ordering ordering = Site_ordering::Row_major, const size_t block = 1)
+		 : ordering_m(ordering), size_m(size), block_m(std::max(block, size_t(1))), to_storage_m(), to_row_major_m()
+		{
+			if(ordering_m != Site_ordering::Row_major){
+				setup_permutation();
+			}
+		}
+
+		static uint64_t morton_key(const std::array<size_t, dim>& x, const size_t bits)
+		{
+			return interleave(x, bits);
+		}
+
+		// Skilling's transpose form of the Hilbert index, "Programming the
+		// Hilbert curve", AIP Conf. Proc. 707 (2004)
+		static uint64_t hilbert_key(std::array<size_t, dim> x, const size_t bits)
+		{
+			const size_t m = size_t(1) << (bits - 1);
+			size_t t;
+			for(size_t Q = m; Q > 1; Q >>= 1){
+				size_t P = Q - 1;
+				for(size_t i = 0; i < dim; i++){
+					if(x[i] & Q){
+						x[0] ^= P;
+					}else{
+						t = (x[0] ^ x[i]) & P;
+						x[0] ^= t;
+						x[i] ^= t;
+					}
+				}
+			}
+			for(size_t i = 1; i < dim; i++){
+				x[i] ^= x[i - 1];
+			}
+			t = 0;
+			for(size_t Q = m; Q > 1; Q >>= 1){
+				if(x[dim - 1] & Q){
+					t ^= Q - 1;
+				}
+			}
+			for(size_t i = 0; i < dim; i++){
+				x[i] ^= t;
+			}
+			// Skilling orders axis 0 as the most significant one
+			std::reverse(x.begin(), x.end());
+			return interleave(x, bits);
+		}
+
+		Site_ordering ordering() const {return ordering_m;}
+		size_t block() const {return block_m;}
+		bool is_row_major() const {return ordering_m == Site_ordering::Row_major;}
+
+		size_t storage_index(const size_t row_major) const
+		{
+			return is_row_major() ? row_major : to_storage_m[row_major];
+		}
+
+		size_t row_major_index(const size_t storage) const
+		{
+			return is_row_major() ? storage : to_row_major_m[storage];
+		}
+
+		template<class T>
+		std::vector<T> to_row_major(const std::vector<T>& storage_ordered) const
+		{
+			if(is_row_major()){
+				return storage_ordered;
+			}
+			std::vector<T> res(storage_ordered.size());
+			for(size_t s = 0; s < res.size(); s++){
+				res[to_row_major_m[s]] = storage_ordered[s];
+			}
+			return res;
+		}
+
+		template<class T>
+		std::vector<T> to_storage(const std::vector<T>& row_major_ordered) const
+		{
+			if(is_row_major()){
+				return row_major_ordered;
+			}
+			std::vector<T> res(row_major_ordered.size());
+			for(size_t r = 0; r < res.size(); r++){
+				res[to_storage_m[r]] = row_major_ordered[r];
+			}
+			return res;
+		}
+};
+
+#endif // SITE_ORDER_H
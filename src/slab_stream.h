@@ -0,0 +1,395 @@
+#ifndef SLAB_STREAM_H
+#define SLAB_STREAM_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <future>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "potts.h"
+#include "splitmix.h"
+
+enum class Slab_update{Sequential, Checkerboard};
+
+// Potts model on a periodic hypercubic lattice with nearest neighbour
+// couplings, whose spin field lives in a file instead of in memory. The file
+// holds one byte per spin in row major order, axis dim - 1 being the slowest,
+// and is updated in slabs of planes perpendicular to that axis. Only three
+// slab buffers with one halo plane on each side are kept in memory; the next
+// slab is read and the previous one written in the background while the
+// current slab is updated. Neighbours are found from the coordinates, so no
+// neighbour table is needed.
+template<size_t dim, size_t q>
+class Slab_stream_t{
+	static_assert(dim >= 2, "Slab_stream_t needs at least two dimensions");
+	static_assert(q >= 2 && q <= 256, "Slab_stream_t stores one byte per spin");
+	public:
+		using spin_type = uint8_t;
+	private:
+		struct Buffer_t{
+			// Planes [lower halo, slab planes..., upper halo]
+			std::vector<spin_type> spins;
+			std::future<void> read, write;
+		};
+
+		std::string path_m;
+		int fd_m;
+		std::array<size_t, dim> size_m;
+		size_t plane_size_m, n_planes_m, slab_planes_m, n_slabs_m;
+		double J_m, H_m, beta_m;
+		// Acceptance probabilities indexed by the change in the number of
+		// equal neighbours and in the number of sites in state 0
+		std::vector<double> accept_m;
+		uint64_t seed_m;
+		size_t n_sweeps_m;
+		std::array<Buffer_t, 3> buffers_m;
+		std::vector<spin_type> first_plane_m;
+
+		void read_bytes(spin_type* dst, const size_t n, const size_t pos) const
+		{
+			size_t done = 0;
+			while(done < n){
+				ssize_t res = ::pread(fd_m, dst + done, n - done, static_cast<off_t>(pos + done));
+				if(res <= 0){
+					throw std::system_error(errno, std::generic_category(), "Reading " + path_m);
+				}
+				done += static_cast<size_t>(res);
+			}
+		}
+
+		void write_bytes(const spin_type* src, const size_t n, const size_t pos) const
+		{
+			size_t done = 0;
+			while(done < n){
+				ssize_t res = ::pwrite(fd_m, src + done, n - done, static_cast<off_t>(pos + done));
+				if(res <= 0){
+					throw std::system_error(errno, std::generic_category(), "Writing " + path_m);
+				}
+				done += static_cast<size_t>(res);
+			}
+		}
+
+		size_t first_plane(const size_t slab) const {return slab*slab_planes_m;}
+		size_t planes(const size_t slab) const {return std::min(slab_planes_m, n_planes_m - first_plane(slab));}
+
+		// Read the planes of slab and the plane above it (the upper halo)
+		void read_slab(Buffer_t& buf, const size_t slab) const
+		{
+			const size_t n = planes(slab);
+			read_bytes(buf.spins.data() + plane_size_m, n*plane_size_m, first_plane(slab)*plane_size_m);
+			const size_t above = (first_plane(slab) + n) % n_planes_m;
+			read_bytes(buf.spins.data() + (n + 1)*plane_size_m, plane_size_m, above*plane_size_m);
+		}
+
+		void write_slab(const Buffer_t& buf, const size_t slab) const
+		{
+			write_bytes(buf.spins.data() + plane_size_m, planes(slab)*plane_size_m, first_plane(slab)*plane_size_m);
+		}
+
+		void update_accept()
+		{
+			accept_m.assign((4*dim + 1)*3, 1);
+			for(size_t k = 0; k < 4*dim + 1; k++){
+				for(size_t h = 0; h < 3; h++){
+					// Energy change with k - 2 dim more equal neighbours and
+					// h - 1 more sites in state 0
+					const double delta_e = -J_m*(static_cast<double>(k) - 2.*dim) - H_m*(static_cast<double>(h) - 1.);
+					accept_m[k*3 + h] = delta_e <= 0 ? 1 : std::exp(-beta_m*delta_e);
+				}
+			}
+		}
+
+		// Next in-plane coordinate, keeping track of the coordinate sum
+		void next_coordinate(std::array<size_t, dim - 1>& c, size_t& parity) const
+		{
+			for(size_t d = 0; d < dim - 1; d++){
+				parity++;
+				if(++c[d] < size_m[d]){
+					return;
+				}
+				parity -= size_m[d];
+				c[d] = 0;
+			}
+		}
+
+		// Metropolis moves of all sites in plane p of the buffer, or only of
+		// those whose coordinates sum to colour modulo 2
+		void update_plane(spin_type* spins, const size_t p, const size_t z, const uint64_t key, const int colour) const
+		{
+			spin_type* const plane = spins + p*plane_size_m;
+			const spin_type* const below = plane - plane_size_m;
+			const spin_type* const above = plane + plane_size_m;
+			std::array<size_t, dim - 1> c;
+			c.fill(0);
+			size_t parity = z;
+			for(size_t i = 0; i < plane_size_m; i++, next_coordinate(c, parity)){
+				if(colour >= 0 && static_cast<int>(parity & 1) != colour){
+					continue;
+				}
+				const spin_type old_spin = plane[i];
+				const uint64_t x = splitmix64(key ^ (z*plane_size_m + i));
+				const spin_type new_spin = static_cast<spin_type>((old_spin + 1 + ((x >> 32)*(q - 1) >> 32)) % q);
+				int k = 2*static_cast<int>(dim);
+				auto count = [&](const spin_type s){k += (s == new_spin) - (s == old_spin);};
+				count(below[i]);
+				count(above[i]);
+				size_t stride = 1;
+				for(size_t d = 0; d < dim - 1; d++){
+					count(plane[c[d] + 1 < size_m[d] ? i + stride : i + stride - size_m[d]*stride]);
+					count(plane[c[d] > 0 ? i - stride : i + (size_m[d] - 1)*stride]);
+					stride *= size_m[d];
+				}
+				const int h = 1 + (new_spin == 0) - (old_spin == 0);
+				const double u = static_cast<double>(x & 0xffffffffULL)*(1./4294967296.);
+				if(u < accept_m[static_cast<size_t>(k)*3 + static_cast<size_t>(h)]){
+					plane[i] = new_spin;
+				}
+			}
+		}
+
+		// Energy and number of sites in each state of plane p of the buffer. Bonds are counted
+		// towards the previous plane, and for the last plane of the lattice also
+		// towards the next one, so that every bond is counted once.
+		void measure_plane(const spin_type* spins, const size_t p, const size_t z, double& energy, std::array<uint64_t, q>& counts) const
+		{
+			const spin_type* const plane = spins + p*plane_size_m;
+			const spin_type* const below = plane - plane_size_m;
+			const spin_type* const above = plane + plane_size_m;
+			std::array<size_t, dim - 1> c;
+			c.fill(0);
+			size_t parity = z;
+			long bonds = 0, zeros = 0;
+			for(size_t i = 0; i < plane_size_m; i++, next_coordinate(c, parity)){
+				const spin_type s = plane[i];
+				bonds += (below[i] == s)*(z > 0) + (above[i] == s)*(z + 1 == n_planes_m);
+				size_t stride = 1;
+				for(size_t d = 0; d < dim - 1; d++){
+					bonds += plane[c[d] + 1 < size_m[d] ? i + stride : i + stride - size_m[d]*stride] == s;
+					stride *= size_m[d];
+				}
+				zeros += s == 0;
+				counts[s]++;
+			}
+			energy -= J_m*static_cast<double>(bonds) + H_m*static_cast<double>(zeros);
+		}
+
+		// One pass over all slabs. colour < 0 updates every site in sequence,
+		// otherwise only sites of that checkerboard colour.
+		void pass(const int colour, const bool update, const bool measure, double& energy, std::array<uint64_t, q>& counts)
+		{
+			const uint64_t key = splitmix64(seed_m ^ splitmix64(2*n_sweeps_m + static_cast<uint64_t>(colour > 0)));
+			for(auto& buf : buffers_m){
+				buf.spins.resize((slab_planes_m + 2)*plane_size_m);
+			}
+			read_bytes(buffers_m[0].spins.data(), plane_size_m, (n_planes_m - 1)*plane_size_m);
+			buffers_m[0].read = std::async(std::launch::async, [this]{read_slab(buffers_m[0], 0);});
+			for(size_t slab = 0; slab < n_slabs_m; slab++){
+				Buffer_t& buf = buffers_m[slab % 3];
+				buf.read.get();
+				if(slab + 1 < n_slabs_m){
+					Buffer_t& next = buffers_m[(slab + 1) % 3];
+					if(next.write.valid()){
+						next.write.get();
+					}
+					next.read = std::async(std::launch::async, [this, &next, slab]{read_slab(next, slab + 1);});
+				}
+				const size_t n = planes(slab);
+				if(slab > 0){
+					const Buffer_t& prev = buffers_m[(slab + 2) % 3];
+					std::memcpy(buf.spins.data(), prev.spins.data() + planes(slab - 1)*plane_size_m, plane_size_m);
+				}
+				if(slab + 1 == n_slabs_m){
+					std::memcpy(buf.spins.data() + (n + 1)*plane_size_m, first_plane_m.data(), plane_size_m);
+				}
+
+				spin_type* const spins = buf.spins.data();
+				const size_t z0 = first_plane(slab);
+				if(update && colour < 0){
+					for(size_t p = 1; p <= n; p++){
+						update_plane(spins, p, z0 + p - 1, key, colour);
+					}
+				}else if(update){
+					// Sites of one colour only have neighbours of the other
+					#pragma omp parallel for schedule(static)
+					for(size_t p = 1; p <= n; p++){
+						update_plane(spins, p, z0 + p - 1, key, colour);
+					}
+				}
+				if(measure){
+					#pragma omp parallel
+					{
+						double e = 0;
+						std::array<uint64_t, q> c;
+						c.fill(0);
+						#pragma omp for schedule(static)
+						for(size_t p = 1; p <= n; p++){
+							measure_plane(spins, p, z0 + p - 1, e, c);
+						}
+						#pragma omp critical
+						{
+							energy += e;
+							for(size_t k = 0; k < q; k++){
+								counts[k] += c[k];
+							}
+						}
+					}
+				}
+
+				if(slab == 0){
+					std::memcpy(first_plane_m.data(), spins + plane_size_m, plane_size_m);
+				}
+				if(update){
+					buf.write = std::async(std::launch::async, [this, &buf, slab]{write_slab(buf, slab);});
+				}
+			}
+			for(auto& buf : buffers_m){
+				if(buf.write.valid()){
+					buf.write.get();
+				}
+			}
+		}
+
+		Observables_t observables(const double energy, const std::array<uint64_t, q>& counts) const
+		{
+			const double n = static_cast<double>(n_sites());
+			double sum = 0, rho2 = 0;
+			for(size_t s = 0; s < q; s++){
+				sum += static_cast<double>(s*counts[s]);
+				rho2 += static_cast<double>(counts[s])*static_cast<double>(counts[s])/(n*n);
+			}
+			const double m2 = (q*rho2 - 1)/(q - 1);
+			return Observables_t{n_sweeps_m, energy/n, sum/n, m2, m2*m2};
+		}
+
+	public:
+		// Open (or create) the spin file at path for a lattice of the given
+		// size, processed slab_planes planes at a time. Every axis needs at
+		// least three sites, so that the two neighbours along it differ. An
+		// existing file of the right size is continued from, otherwise the
+		// spins are initialised at random.
+		Slab_stream_t(const std::string& path, const std::array<size_t, dim>& size, const size_t slab_planes, const uint64_t seed = std::random_device()())
+		 : path_m(path), fd_m(-1), size_m(size), plane_size_m(1), n_planes_m(size[dim - 1]),
+		 slab_planes_m(slab_planes), n_slabs_m(0), J_m(1), H_m(0), beta_m(0), accept_m(), seed_m(seed),
+		 n_sweeps_m(0), buffers_m(), first_plane_m()
+		{
+			for(size_t d = 0; d < dim - 1; d++){
+				plane_size_m *= size_m[d];
+			}
+			for(size_t d = 0; d < dim; d++){
+				if(size_m[d] < 3){
+					throw std::invalid_argument("Every axis needs at least three sites");
+				}
+			}
+			if(slab_planes_m == 0){
+				throw std::invalid_argument("Slabs need at least one plane");
+			}
+			n_slabs_m = (n_planes_m + slab_planes_m - 1)/slab_planes_m;
+			if(n_slabs_m < 2){
+				throw std::invalid_argument("The lattice must be split into at least two slabs");
+			}
+			first_plane_m.resize(plane_size_m);
+			update_accept();
+
+			fd_m = ::open(path_m.c_str(), O_RDWR | O_CREAT, 0644);
+			if(fd_m < 0){
+				throw std::system_error(errno, std::generic_category(), "Opening " + path_m);
+			}
+			struct stat st;
+			if(::fstat(fd_m, &st) == 0 && static_cast<size_t>(st.st_size) == n_sites()){
+				return;
+			}
+			if(::ftruncate(fd_m, static_cast<off_t>(n_sites())) != 0){
+				::close(fd_m);
+				throw std::system_error(errno, std::generic_category(), "Resizing " + path_m);
+			}
+			std::vector<spin_type> slab(slab_planes_m*plane_size_m);
+			for(size_t s = 0; s < n_slabs_m; s++){
+				const size_t n = planes(s)*plane_size_m, offset = first_plane(s)*plane_size_m;
+				for(size_t i = 0; i < n; i++){
+					slab[i] = static_cast<spin_type>((splitmix64(seed_m ^ (offset + i)) >> 32)*q >> 32);
+				}
+				write_bytes(slab.data(), n, offset);
+			}
+		}
+
+		Slab_stream_t(const Slab_stream_t&) = delete;
+		Slab_stream_t& operator=(const Slab_stream_t&) = delete;
+
+		~Slab_stream_t()
+		{
+			::fsync(fd_m);
+			::close(fd_m);
+		}
+
+		size_t n_sites() const {return plane_size_m*n_planes_m;}
+		size_t n_slabs() const {return n_slabs_m;}
+		size_t n_sweeps() const {return n_sweeps_m;}
+		const std::string& path() const {return path_m;}
+
+		// Memory used for spins, independent of the lattice size
+		size_t bytes_in_memory() const {return (3*(slab_planes_m + 2) + 1)*plane_size_m*sizeof(spin_type);}
+
+		void set_J(const double J){J_m = J; update_accept();}
+		void set_H(const double H){H_m = H; update_accept();}
+		void set_beta(const double beta){beta_m = beta; update_accept();}
+		double J() const {return J_m;}
+		double H() const {return H_m;}
+		double beta() const {return beta_m;}
+
+		// Metropolis sweeps, returns the observables after the last sweep,
+		// measured while the last slabs are written. Checkerboard sweeps update
+		// the two colours in separate passes over the file and need even
+		// lattice sizes.
+		Observables_t sweep(const size_t n_sweeps = 1, const Slab_update mode = Slab_update::Checkerboard)
+		{
+			if(mode == Slab_update::Checkerboard){
+				for(const auto L : size_m){
+					if(L % 2 != 0){
+						throw std::invalid_argument("Checkerboard updates need even lattice sizes");
+					}
+				}
+			}
+			double energy = 0;
+			std::array<uint64_t, q> counts;
+			counts.fill(0);
+			for(size_t it = 0; it < n_sweeps; it++){
+				const bool measure = it + 1 == n_sweeps;
+				if(mode == Slab_update::Checkerboard){
+					pass(0, true, false, energy, counts);
+					pass(1, true, measure, energy, counts);
+				}else{
+					pass(-1, true, measure, energy, counts);
+				}
+				n_sweeps_m++;
+			}
+			return observables(energy, counts);
+		}
+
+		// Measure the current configuration in one read-only pass
+		Observables_t observables()
+		{
+			double energy = 0;
+			std::array<uint64_t, q> counts;
+			counts.fill(0);
+			pass(-1, false, true, energy, counts);
+			return observables(energy, counts);
+		}
+
+		// Configuration in row major order, only sensible for small lattices
+		std::vector<spin_type> snapshot() const
+		{
+			std::vector<spin_type> res(n_sites());
+			read_bytes(res.data(), res.size(), 0);
+			return res;
+		}
+};
+
+#endif // SLAB_STREAM_H
@@ -0,0 +1,304 @@
+#ifndef SPIN_STORAGE_H
+#define SPIN_STORAGE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include "memory.h"
+
+// Number of bits used to store one spin taking q different values
+template<size_t q>
+struct Spin_bits{
+	static constexpr size_t value = q <= 2 ? 1 : (q <= 4 ? 2 : (q <= 16 ? 4 :
+		(q <= (size_t(1) << 8) ? 8 : (q <= (size_t(1) << 16) ? 16 : 32))));
+};
+
+// Proxy returned by the non-const operator[] of packed storages, behaves like
+// a reference to a single spin
+template<class Storage>
+class Spin_reference_t{
+	public:
+		using value_type = typename Storage::value_type;
+	private:
+		Storage& storage_m;
+		size_t index_m;
+	public:
+		Spin_reference_t(Storage& s, const size_t index) : storage_m(s), index_m(index) {}
+		Spin_reference_t(const Spin_reference_t&) = default;
+
+		operator value_type() const {return storage_m.get(index_m);}
+
+		Spin_reference_t& operator=(const value_type val)
+		{
+			storage_m.set(index_m, val);
+			return *this;
+		}
+
+		Spin_reference_t& operator=(const Spin_reference_t& other)
+		{
+			storage_m.set(index_m, static_cast<value_type>(other));
+			return *this;
+		}
+};
+
+// Read only iterator over the spin values of a storage
+template<class Storage>
+class Spin_iterator_t{
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = typename Storage::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = value_type;
+	private:
+		const Storage* storage_m;
+		size_t index_m;
+	public:
+		Spin_iterator_t() : storage_m(nullptr), index_m(0) {}
+		Spin_iterator_t(const Storage& s, const size_t index) : storage_m(&s), index_m(index) {}
+
+		value_type operator*() const {return storage_m->get(index_m);}
+		value_type operator[](const std::ptrdiff_t n) const {return storage_m->get(static_cast<size_t>(static_cast<std::ptrdiff_t>(index_m) + n));}
+
+		Spin_iterator_t& operator++(){index_m++; return *this;}
+		Spin_iterator_t operator++(int){Spin_iterator_t tmp(*this); index_m++; return tmp;}
+		Spin_iterator_t& operator--(){index_m--; return *this;}
+		Spin_iterator_t operator--(int){Spin_iterator_t tmp(*this); index_m--; return tmp;}
+		Spin_iterator_t& operator+=(const std::ptrdiff_t n){index_m = static_cast<size_t>(static_cast<std::ptrdiff_t>(index_m) + n); return *this;}
+		Spin_iterator_t& operator-=(const std::ptrdiff_t n){return *this += -n;}
+		Spin_iterator_t operator+(const std::ptrdiff_t n) const {Spin_iterator_t tmp(*this); return tmp += n;}
+		Spin_iterator_t operator-(const std::ptrdiff_t n) const {Spin_iterator_t tmp(*this); return tmp -= n;}
+		std::ptrdiff_t operator-(const Spin_iterator_t& other) const {return static_cast<std::ptrdiff_t>(index_m) - static_cast<std::ptrdiff_t>(other.index_m);}
+
+		bool operator==(const Spin_iterator_t& other) const {return index_m == other.index_m;}
+		bool operator!=(const Spin_iterator_t& other) const {return index_m != other.index_m;}
+		bool operator<(const Spin_iterator_t& other) const {return index_m < other.index_m;}
+		bool operator>(const Spin_iterator_t& other) const {return index_m > other.index_m;}
+		bool operator<=(const Spin_iterator_t& other) const {return index_m <= other.index_m;}
+		bool operator>=(const Spin_iterator_t& other) const {return index_m >= other.index_m;}
+};
+
+// Spins stored bits at a time in 64 bit words, spin i lives in word
+// i/spins_per_word. Writing a spin is a read-modify-write of the whole word,
+// so concurrent updates have to be partitioned on word boundaries.
+template<size_t bits>
+class Packed_spins_t{
+	static_assert(bits == 1 || bits == 2 || bits == 4, "Packed spins must use 1, 2 or 4 bits");
+	public:
+		using value_type = uint8_t;
+		using word_type = uint64_t;
+		using reference = Spin_reference_t<Packed_spins_t<bits>>;
+		using const_iterator = Spin_iterator_t<Packed_spins_t<bits>>;
+		static constexpr size_t bits_per_spin = bits;
+		static constexpr size_t spins_per_word = 64/bits;
+		static constexpr word_type spin_mask = (word_type(1) << bits) - 1;
+	private:
+		size_t size_m;
+		Lattice_vector<word_type> words_m;
+
+		// Word with the value val repeated in every spin slot
+		static word_type broadcast(const value_type val)
+		{
+			word_type res = 0;
+			for(size_t i = 0; i < spins_per_word; i++){
+				res |= static_cast<word_type>(val) << (bits*i);
+			}
+			return res;
+		}
+
+		// Word with only the lowest bit of every spin slot set
+		static word_type low_bits()
+		{
+			return broadcast(1);
+		}
+
+		// Mask selecting the spin slots of word w_idx that are in use
+		word_type valid_mask(const size_t w_idx) const
+		{
+			size_t n_valid = size_m - w_idx*spins_per_word;
+			if(n_valid >= spins_per_word){
+				return ~word_type(0);
+			}
+			return (word_type(1) << (bits*n_valid)) - 1;
+		}
+
+		static size_t popcount(const word_type w)
+		{
+			return static_cast<size_t>(__builtin_popcountll(w));
+		}
+
+	public:
+		Packed_spins_t() : size_m(0), words_m() {}
+		explicit Packed_spins_t(const size_t n)
+		 : size_m(n), words_m((n + spins_per_word - 1)/spins_per_word)
+		{}
+
+		size_t size() const {return size_m;}
+		size_t n_words() const {return words_m.size();}
+		size_t bytes() const {return words_m.size()*sizeof(word_type);}
+		word_type* data(){return words_m.data();}
+		const word_type* data() const {return words_m.data();}
+
+		value_type get(const size_t index) const
+		{
+			return static_cast<value_type>((words_m[index/spins_per_word] >> (bits*(index % spins_per_word))) & spin_mask);
+		}
+
+		void set(const size_t index, const value_type val)
+		{
+			word_type& w = words_m[index/spins_per_word];
+			const size_t shift = bits*(index % spins_per_word);
+			w = (w & ~(spin_mask << shift)) | (static_cast<word_type>(val) << shift);
+		}
+
+		reference operator[](const size_t index){return reference(*this, index);}
+		value_type operator[](const size_t index) const {return get(index);}
+
+		const_iterator begin() const {return const_iterator(*this, 0);}
+		const_iterator end() const {return const_iterator(*this, size_m);}
+
+		void fill(const value_type val)
+		{
+			const word_type w = broadcast(val);
+			for(size_t w_idx = 0; w_idx < words_m.size(); w_idx++){
+				words_m[w_idx] = w & valid_mask(w_idx);
+			}
+		}
+
+		// Number of spins equal to val, a whole word at a time
+		size_t count(const value_type val) const
+		{
+			const word_type pattern = broadcast(val), low = low_bits();
+			size_t res = 0;
+			for(size_t w_idx = 0; w_idx < words_m.size(); w_idx++){
+				// Slots equal to val become zero, fold every slot onto its lowest bit
+				word_type x = words_m[w_idx] ^ pattern;
+				for(size_t shift = 1; shift < bits; shift *= 2){
+					x |= x >> shift;
+				}
+				x = ~x & low & valid_mask(w_idx);
+				res += popcount(x);
+			}
+			return res;
+		}
+
+		// Sum of all spin values, one popcount per bit plane
+		uint64_t sum() const
+		{
+			const word_type low = low_bits();
+			uint64_t res = 0;
+			for(const auto w : words_m){
+				for(size_t b = 0; b < bits; b++){
+					res += static_cast<uint64_t>(popcount(w & (low << b))) << b;
+				}
+			}
+			return res;
+		}
+
+		std::vector<value_type> unpack() const
+		{
+			std::vector<value_type> res(size_m);
+			for(size_t i = 0; i < size_m; i++){
+				res[i] = get(i);
+			}
+			return res;
+		}
+
+		void pack(const std::vector<value_type>& spins)
+		{
+			*this = Packed_spins_t(spins.size());
+			for(size_t i = 0; i < size_m; i++){
+				set(i, spins[i]);
+			}
+		}
+};
+
+template<size_t bits> constexpr size_t Packed_spins_t<bits>::bits_per_spin;
+template<size_t bits> constexpr size_t Packed_spins_t<bits>::spins_per_word;
+template<size_t bits> constexpr typename Packed_spins_t<bits>::word_type Packed_spins_t<bits>::spin_mask;
+
+// One spin per element of type T
+template<class T>
+class Plain_spins_t{
+	public:
+		using value_type = T;
+		using word_type = T;
+		using reference = T&;
+		using const_iterator = typename Lattice_vector<T>::const_iterator;
+		static constexpr size_t bits_per_spin = 8*sizeof(T);
+		static constexpr size_t spins_per_word = 1;
+	private:
+		Lattice_vector<T> spins_m;
+	public:
+		Plain_spins_t() : spins_m() {}
+		explicit Plain_spins_t(const size_t n) : spins_m(n) {}
+
+		size_t size() const {return spins_m.size();}
+		size_t n_words() const {return spins_m.size();}
+		size_t bytes() const {return spins_m.size()*sizeof(T);}
+		T* data(){return spins_m.data();}
+		const T* data() const {return spins_m.data();}
+
+		value_type get(const size_t index) const {return spins_m[index];}
+		void set(const size_t index, const value_type val){spins_m[index] = val;}
+
+		reference operator[](const size_t index){return spins_m[index];}
+		value_type operator[](const size_t index) const {return spins_m[index];}
+
+		const_iterator begin() const {return spins_m.begin();}
+		const_iterator end() const {return spins_m.end();}
+
+		void fill(const value_type val){std::fill(spins_m.begin(), spins_m.end(), val);}
+
+		size_t count(const value_type val) const
+		{
+			size_t res = 0;
+			for(const auto spin : spins_m){
+				res += (spin == val);
+			}
+			return res;
+		}
+
+		uint64_t sum() const
+		{
+			uint64_t res = 0;
+			for(const auto spin : spins_m){
+				res += spin;
+			}
+			return res;
+		}
+
+		std::vector<value_type> unpack() const {return std::vector<value_type>(spins_m.begin(), spins_m.end());}
+		void pack(const std::vector<value_type>& spins){spins_m.assign(spins.begin(), spins.end());}
+};
+
+template<class T> constexpr size_t Plain_spins_t<T>::bits_per_spin;
+template<class T> constexpr size_t Plain_spins_t<T>::spins_per_word;
+
+template<size_t q, size_t bits = Spin_bits<q>::value>
+struct Spin_storage_selector{
+	using type = Packed_spins_t<bits>;
+};
+
+template<size_t q>
+struct Spin_storage_selector<q, 8>{
+	using type = Plain_spins_t<uint8_t>;
+};
+
+template<size_t q>
+struct Spin_storage_selector<q, 16>{
+	using type = Plain_spins_t<uint16_t>;
+};
+
+template<size_t q>
+struct Spin_storage_selector<q, 32>{
+	using type = Plain_spins_t<uint32_t>;
+};
+
+// Storage policy for spins taking q different values
+template<size_t q>
+using Spin_storage_t = typename Spin_storage_selector<q>::type;
+
+#endif // SPIN_STORAGE_H
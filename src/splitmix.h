@@ -0,0 +1,25 @@
+#ifndef SPLITMIX_H
+#define SPLITMIX_H
+
+#include <cstdint>
+
+// SplitMix64 (Steele, Lea and Flood, OOPSLA 2014). splitmix64(x) hashes x to a
+// well mixed 64 bit value, used for seeds of independent streams and for
+// counter based random numbers. splitmix64_next(x) is the generator with state
+// x, returning the next output and advancing the state.
+inline uint64_t splitmix64(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27))*0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+inline uint64_t splitmix64_next(uint64_t& x)
+{
+	const uint64_t res = splitmix64(x);
+	x += 0x9e3779b97f4a7c15ULL;
+	return res;
+}
+
+#endif // SPLITMIX_H
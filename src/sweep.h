@@ -0,0 +1,41 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <cstddef>
+#include <functional>
+
+// Cluster is a single cluster (Wolff) move, Swendsen_Wang flips all
+// Fortuin-Kasteleyn clusters of the lattice
+enum class Move_type{Metropolis, Heat_bath, Cluster, Swendsen_Wang};
+
+// Order in which single spin moves visit the sites during a sweep
+enum class Visit_order{Random, Sequential, Permutation};
+
+struct Observables_t{
+	size_t sweep;
+	double energy;
+	double magnetization;
+	// |M|^2 and |M|^4 of the Potts order parameter vector, normalised to 1 in
+	// a fully ordered state. The susceptibility is beta N <m2> (above Tc) and
+	// the Binder cumulant follows from <m4>/<m2>^2.
+	double m2;
+	double m4;
+};
+
+struct Sweep_options_t{
+	Move_type move = Move_type::Metropolis;
+	Visit_order order = Visit_order::Random;
+	// Number of cluster moves making up one sweep for Move_type::Cluster
+	size_t cluster_moves = 1;
+	// Report cluster (improved) estimators for cluster moves at H = 0: m2 and
+	// m4 from the cluster size moments of Swendsen-Wang moves, and the spin
+	// correlations from co-membership in a cluster. Wolff moves report m2 and
+	// m4 of the configuration, as a single cluster gives no estimator of m4
+	// to pair with |C|/N for m2.
+	bool improved_estimators = false;
+	// Call measure every measure_every sweeps, 0 disables measurements
+	size_t measure_every = 0;
+	std::function<void(const Observables_t&)> measure;
+};
+
+#endif // SWEEP_H
@@ -0,0 +1,104 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <exception>
+
+// Work stealing pool for batches of independent jobs. Every worker has its
+// own queue, filled round robin in the order the jobs are given, and takes
+// jobs from its front. A worker with an empty queue steals from the back of
+// the other queues, so with the jobs sorted by decreasing cost the large
+// jobs start first and the small ones fill the gaps at the end.
+class Work_stealing_pool_t{
+	private:
+		using Job = std::function<void()>;
+		struct Queue_t{
+			std::mutex lock;
+			std::deque<Job> jobs;
+		};
+
+		size_t n_threads_m;
+		std::vector<std::unique_ptr<Queue_t>> queues_m;
+
+		bool pop(const size_t worker, Job& job)
+		{
+			Queue_t& queue = *queues_m[worker];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if(queue.jobs.empty()){
+				return false;
+			}
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			return true;
+		}
+
+		bool steal(const size_t worker, Job& job)
+		{
+			for(size_t k = 1; k < n_threads_m; k++){
+				Queue_t& queue = *queues_m[(worker + k) % n_threads_m];
+				std::lock_guard<std::mutex> guard(queue.lock);
+				if(!queue.jobs.empty()){
+					job = std::move(queue.jobs.back());
+					queue.jobs.pop_back();
+					return true;
+				}
+			}
+			return false;
+		}
+
+	public:
+		// n_threads = 0 uses one thread per hardware thread
+		explicit Work_stealing_pool_t(const size_t n_threads = 0)
+		 : n_threads_m(n_threads > 0 ? n_threads : std::max(1u, std::thread::hardware_concurrency())), queues_m()
+		{
+			for(size_t t = 0; t < n_threads_m; t++){
+				queues_m.emplace_back(new Queue_t());
+			}
+		}
+
+		size_t n_threads() const {return n_threads_m;}
+
+		// Run all jobs and wait for them to finish. Jobs are not added while
+		// running, so a worker stops once all queues are empty. The first
+		// exception thrown by a job is rethrown here after all workers are done.
+		void run(std::vector<Job> jobs)
+		{
+			for(size_t i = 0; i < jobs.size(); i++){
+				queues_m[i % n_threads_m]->jobs.push_back(std::move(jobs[i]));
+			}
+			std::exception_ptr error;
+			std::mutex error_lock;
+			auto work = [&](const size_t worker){
+				Job job;
+				while(pop(worker, job) || steal(worker, job)){
+					try{
+						job();
+					}catch(...){
+						std::lock_guard<std::mutex> guard(error_lock);
+						if(!error){
+							error = std::current_exception();
+						}
+					}
+				}
+			};
+			std::vector<std::thread> threads;
+			for(size_t t = 1; t < n_threads_m; t++){
+				threads.emplace_back(work, t);
+			}
+			work(0);
+			for(auto& thread : threads){
+				thread.join();
+			}
+			if(error){
+				std::rethrow_exception(error);
+			}
+		}
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+#include "potts_instances.h"
+#include "cli_options.h"
+#include "transfer_matrix.h"
+#include "GSLpp/error.h"
+
+// Exact free energy, energy and correlation length of infinitely long strips
+// from the transfer matrix. Usage:
+//   potts-transfer key=value ...
+// with the keys (defaults in brackets), see cli_options.h for the syntax
+//   dim, q          lattice dimension and number of states (2, 2)
+//   W               width of the strip, layers have W^(dim - 1) sites, at
+//                   least 5 as the couplings are read from a W^dim lattice (6)
+//   periodic        periodic boundaries across the strip, 0 or 1 (1)
+//   beta            comma separated list or range start:stop:step (1)
+//   J               comma separated shell couplings (1)
+//   H               field (0)
+//   tolerance       relative tolerance of the eigenvalues (1e-12)
+//   vectors         vectors in the subspace iteration (4)
+// Uses the models compiled into libpotts.
+
+template<size_t dim, size_t q>
+void solve(const Options& options)
+{
+	const size_t W = parse_size(option(options, "W", "6"));
+	std::array<size_t, dim> size;
+	size.fill(W);
+	GSL::Matrix m(dim, dim);
+	for(size_t i = 0; i < dim; i++){
+		m[i][i] = static_cast<double>(W);
+	}
+	Potts_t<dim, q> strip(Lattice_t<dim>(m), size, parse_size(option(options, "periodic", "1")) != 0);
+	strip.set_interaction_parameters(parse_numbers(option(options, "J", "1")));
+	strip.set_H(parse_number(option(options, "H", "0")));
+
+	Transfer_matrix_t<dim, q> transfer(strip);
+	std::cout << "# " << transfer.width() << " sites per layer, " << transfer.n_states() << " states, ";
+	std::cout << transfer.n_buffers() << " buffer spins\n";
+	std::cout << "# beta free_energy energy correlation_length iterations seconds\n";
+	const double tolerance = parse_number(option(options, "tolerance", "1e-12"));
+	const size_t n_vectors = parse_size(option(options, "vectors", "4"));
+	std::cout.precision(12);
+	for(const double beta : parse_numbers(option(options, "beta", "1"))){
+		const auto start = std::chrono::steady_clock::now();
+		const Transfer_result_t res = transfer.solve(beta, tolerance, 100000, n_vectors);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << res.beta << " " << res.free_energy << " " << res.energy << " " << res.correlation_length << " ";
+		std::cout << res.iterations << " " << seconds << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	GSL::Error_handler e_handler;
+	e_handler.off();
+
+	try{
+		const Options options = read_options(argc, argv, {"config", "dim", "q", "W", "periodic", "beta", "J", "H", "tolerance", "vectors"});
+		const size_t dim = parse_size(option(options, "dim", "2"));
+		const size_t q = parse_size(option(options, "q", "2"));
+		bool found = false;
+#define POTTS_SOLVE(d, n) \
+		if(!found && dim == d && q == n){ \
+			solve<d, n>(options); \
+			found = true; \
+		}
+		POTTS_INSTANCES(POTTS_SOLVE)
+#undef POTTS_SOLVE
+		if(!found){
+			throw std::invalid_argument("libpotts has no model for dim = " + std::to_string(dim) + ", q = " + std::to_string(q));
+		}
+	}catch(const std::exception& e){
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,615 @@
+#ifndef TRANSFER_MATRIX_H
+#define TRANSFER_MATRIX_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "potts.h"
+#include "memory.h"
+#include "splitmix.h"
+
+// Results of the transfer matrix for an infinitely long strip at one beta
+struct Transfer_result_t{
+	double beta;
+	// ln of the leading eigenvalue, the free energy -ln(lambda_0)/(beta W)
+	// and the energy per site, W the number of sites in a layer
+	double log_lambda;
+	double free_energy;
+	double energy;
+	// 1/ln(lambda_0/|lambda_1|) in layer spacings
+	double correlation_length;
+	size_t iterations;
+};
+
+// Transfer matrix along the last axis of a Potts_t, with the couplings J and
+// the field H of the model and its boundary conditions across the strip. The
+// layer seen by the transfer matrix is the cross section at the middle of the
+// last axis, for example the W sites of a row of Potts_t<2, q> of size
+// {W, W}. Its couplings are read from the neighbour table, so the model needs
+// at least five layers and the couplings may only reach the next layer,
+// with the same coupling from old site j to new site k as from old k to new
+// j (not the case on a triangular lattice). Per bond couplings are not
+// supported.
+//
+// T = D^1/2 T' D^1/2 is symmetric, with D the Boltzmann weight of the bonds
+// inside a layer and of the field, and T' that of the bonds between layers.
+// T' is applied matrix free as a product of sparse factors, each of which
+// replaces the spin of one site in the old layer by that in the new layer,
+// so applying T to a vector of the q^W layer states costs O(W q^(W+1)).
+// Couplings between a site and sites replaced before it, diagonal bonds say,
+// need the old spin kept in extra buffer spins until its last use, which
+// multiplies the memory by q per buffer spin (at most two for diagonal bonds
+// across a periodic strip).
+//
+// The leading eigenvalues are found by subspace iteration with Rayleigh-Ritz
+// on a few vectors, which are kept to start the next beta of a scan. The
+// energy is the exact Hellmann-Feynman derivative <psi|dT/dbeta|psi>/lambda,
+// with dT/dbeta applied along with T. The factors are shifted so that no
+// weight exceeds one, apply() multiplies by exp(-beta energy_shift()) T.
+template<size_t dim, size_t q>
+class Transfer_matrix_t{
+	private:
+		enum class Step_type{Copy, Replace, Free};
+		// Copy the old spin at site into buffer slot, replace the spin at
+		// site coupling the new spin to the spins at sources and with self to
+		// the old spin, or sum out buffer slot
+		struct Step_t{
+			Step_type type;
+			size_t site, slot;
+			std::vector<size_t> sources;
+			std::vector<double> J;
+			double self, offset;
+		};
+
+		size_t n_layer_m, n_buffers_m, n_states_m, n_extended_m;
+		std::vector<size_t> stride_m;
+		std::vector<Step_t> steps_m;
+		std::vector<double> layer_energy_m;
+		double min_layer_energy_m, shift_m;
+		uint64_t random_state_m;
+		// Weights of the steps at the current beta, for each step one entry
+		// per mask of sources with the same new spin
+		double beta_m;
+		std::vector<std::vector<double>> same_m, diff_m, exponent_m;
+		Lattice_vector<double> diagonal_m;
+		Lattice_vector<double> work_m, next_m, d_work_m, d_next_m;
+		std::vector<Lattice_vector<double>> vectors_m;
+
+		size_t digit(const size_t x, const size_t position) const
+		{
+			return (x/stride_m[position]) % q;
+		}
+
+		// Layers along the last axis, the middle one is the reference layer
+		void setup(const Potts_t<dim, q>& strip)
+		{
+			if(strip.bond_couplings()){
+				throw std::invalid_argument("Transfer matrices need shell couplings, not per bond couplings");
+			}
+			const size_t n_layers = strip.size()[dim - 1];
+			if(n_layers < 5){
+				throw std::invalid_argument("The strip needs at least five layers along the last axis");
+			}
+			n_layer_m = strip.field().size()/n_layers;
+			const size_t layer = n_layers/2;
+			const auto& nn = strip.neighbours();
+			const auto& order = strip.order();
+			const size_t n_shells = std::min(strip.J().size(), nn.n_shells());
+
+			// Bonds from old site j (this layer) to new site k (next layer)
+			std::vector<std::vector<std::pair<size_t, double>>> bonds(n_layer_m);
+			std::vector<std::vector<std::pair<size_t, double>>> intra(n_layer_m);
+			for(size_t j = 0; j < n_layer_m; j++){
+				const size_t s = order.storage_index(layer*n_layer_m + j);
+				for(size_t shell = 0; shell < n_shells; shell++){
+					const double J = strip.J()[shell];
+					for(auto n = nn.begin(s, shell); n != nn.end(s, shell); n++){
+						const size_t rm = order.row_major_index(*n);
+						const size_t l = rm/n_layer_m, k = rm % n_layer_m;
+						if(l == layer){
+							intra[j].emplace_back(k, J);
+						}else if(l == layer + 1){
+							bonds[k].emplace_back(j, J);
+						}else if(l != layer - 1){
+							throw std::invalid_argument("Couplings reaching beyond the next layer need a wider transfer matrix");
+						}
+					}
+				}
+			}
+			// T' is only symmetric if the coupling from old site j to new site
+			// k equals that from old k to new j, which fails on a triangular
+			// lattice for example
+			std::vector<double> coupling(n_layer_m*n_layer_m, 0);
+			for(size_t k = 0; k < n_layer_m; k++){
+				for(const auto& bond : bonds[k]){
+					coupling[bond.first*n_layer_m + k] += bond.second;
+				}
+			}
+			for(size_t j = 0; j < n_layer_m; j++){
+				for(size_t k = 0; k < j; k++){
+					const double a = coupling[j*n_layer_m + k], b = coupling[k*n_layer_m + j];
+					if(std::abs(a - b) > 1e-12*std::max(std::abs(a), std::abs(b))){
+						throw std::invalid_argument("Couplings between layers are not symmetric, the transfer matrix would not be");
+					}
+				}
+			}
+			setup_layer_energy(intra, strip.H());
+			setup_steps(bonds);
+		}
+
+		// Energy of the bonds inside a layer and of the field, every bond
+		// is seen from both ends
+		void setup_layer_energy(const std::vector<std::vector<std::pair<size_t, double>>>& intra, const double H)
+		{
+			n_states_m = 1;
+			for(size_t i = 0; i < n_layer_m; i++){
+				if(n_states_m > std::numeric_limits<uint32_t>::max()/q){
+					throw std::length_error("Too many layer states for the transfer matrix");
+				}
+				n_states_m *= q;
+			}
+			stride_m.assign(1, 1);
+			for(size_t i = 0; i < n_layer_m; i++){
+				stride_m.push_back(stride_m.back()*q);
+			}
+			layer_energy_m.assign(n_states_m, 0);
+			#pragma omp parallel for schedule(static)
+			for(size_t x = 0; x < n_states_m; x++){
+				double energy = 0;
+				for(size_t j = 0; j < n_layer_m; j++){
+					const size_t s = digit(x, j);
+					for(const auto& bond : intra[j]){
+						if(digit(x, bond.first) == s){
+							energy -= bond.second/2;
+						}
+					}
+					if(s == 0){
+						energy -= H;
+					}
+				}
+				layer_energy_m[x] = energy;
+			}
+			min_layer_energy_m = *std::min_element(layer_energy_m.begin(), layer_energy_m.end());
+		}
+
+		// Replace the sites in order, copying old spins still needed after
+		// their site has been replaced into buffer slots
+		void setup_steps(const std::vector<std::vector<std::pair<size_t, double>>>& bonds)
+		{
+			std::vector<size_t> last_use(n_layer_m, 0);
+			for(size_t k = 0; k < n_layer_m; k++){
+				for(const auto& bond : bonds[k]){
+					last_use[bond.first] = std::max(last_use[bond.first], k);
+				}
+			}
+			std::vector<size_t> slot(n_layer_m, 0), free_slots;
+			n_buffers_m = 0;
+			shift_m = -min_layer_energy_m;
+			steps_m.clear();
+			for(size_t k = 0; k < n_layer_m; k++){
+				if(last_use[k] > k){
+					if(free_slots.empty()){
+						free_slots.push_back(n_buffers_m++);
+					}
+					slot[k] = free_slots.back();
+					free_slots.pop_back();
+					steps_m.push_back(Step_t{Step_type::Copy, k, slot[k], {}, {}, 0, 0});
+				}
+				Step_t step{Step_type::Replace, k, 0, {}, {}, 0, 0};
+				for(const auto& bond : bonds[k]){
+					if(bond.first == k){
+						step.self += bond.second;
+						continue;
+					}
+					// Layer sites are positions 0 to W - 1, buffer slots follow
+					const size_t source = bond.first > k ? bond.first : n_layer_m + slot[bond.first];
+					const auto it = std::find(step.sources.begin(), step.sources.end(), source);
+					if(it == step.sources.end()){
+						step.sources.push_back(source);
+						step.J.push_back(bond.second);
+					}else{
+						step.J[static_cast<size_t>(it - step.sources.begin())] += bond.second;
+					}
+				}
+				if(step.sources.size() > 20){
+					throw std::invalid_argument("Too many couplings between layers for the transfer matrix");
+				}
+				step.offset = std::max(step.self, 0.);
+				for(const double J : step.J){
+					step.offset += std::max(J, 0.);
+				}
+				shift_m += step.offset;
+				steps_m.push_back(step);
+				for(size_t j = 0; j < k; j++){
+					if(last_use[j] == k && last_use[j] > j){
+						steps_m.push_back(Step_t{Step_type::Free, j, slot[j], {}, {}, 0, 0});
+						free_slots.push_back(slot[j]);
+					}
+				}
+			}
+			for(size_t b = 0; b < n_buffers_m; b++){
+				if(stride_m.back() > std::numeric_limits<uint32_t>::max()/q){
+					throw std::length_error("Too many buffer states for the transfer matrix");
+				}
+				stride_m.push_back(stride_m.back()*q);
+			}
+			n_extended_m = stride_m[n_layer_m + n_buffers_m];
+			same_m.resize(steps_m.size());
+			diff_m.resize(steps_m.size());
+			exponent_m.resize(steps_m.size());
+		}
+
+		void set_beta(const double beta)
+		{
+			if(beta == beta_m && !diagonal_m.empty()){
+				return;
+			}
+			beta_m = beta;
+			diagonal_m.resize(n_states_m);
+			#pragma omp parallel for schedule(static)
+			for(size_t x = 0; x < n_states_m; x++){
+				diagonal_m[x] = std::exp(-beta*(layer_energy_m[x] - min_layer_energy_m)/2);
+			}
+			for(size_t i = 0; i < steps_m.size(); i++){
+				const Step_t& step = steps_m[i];
+				if(step.type != Step_type::Replace){
+					continue;
+				}
+				const size_t n_masks = size_t(1) << step.sources.size();
+				same_m[i].resize(n_masks);
+				diff_m[i].resize(n_masks);
+				exponent_m[i].resize(n_masks);
+				for(size_t mask = 0; mask < n_masks; mask++){
+					double a = -step.offset;
+					for(size_t s = 0; s < step.sources.size(); s++){
+						if(mask & (size_t(1) << s)){
+							a += step.J[s];
+						}
+					}
+					exponent_m[i][mask] = a;
+					diff_m[i][mask] = std::exp(beta*a);
+					same_m[i][mask] = std::exp(beta*(a + step.self));
+				}
+			}
+		}
+
+		// One factor of T', w = F v and with derivative dw = F' v + F dv
+		template<bool derivative>
+		void apply_step(const size_t i, const double* v, double* w, const double* dv, double* dw) const
+		{
+			const Step_t& step = steps_m[i];
+			const size_t stride = stride_m[step.site];
+			switch(step.type){
+				case Step_type::Copy:{
+					const size_t slot_stride = stride_m[n_layer_m + step.slot];
+					#pragma omp parallel for schedule(static)
+					for(size_t x = 0; x < n_extended_m; x++){
+						const size_t b = digit(x, n_layer_m + step.slot);
+						const bool keep = b == digit(x, step.site);
+						w[x] = keep ? v[x - b*slot_stride] : 0;
+						if(derivative){
+							dw[x] = keep ? dv[x - b*slot_stride] : 0;
+						}
+					}
+					break;
+				}
+				case Step_type::Free:{
+					const size_t slot_stride = stride_m[n_layer_m + step.slot];
+					#pragma omp parallel for schedule(static)
+					for(size_t x = 0; x < n_extended_m; x++){
+						double sum = 0, d_sum = 0;
+						if(digit(x, n_layer_m + step.slot) == 0){
+							for(size_t b = 0; b < q; b++){
+								sum += v[x + b*slot_stride];
+								if(derivative){
+									d_sum += dv[x + b*slot_stride];
+								}
+							}
+						}
+						w[x] = sum;
+						if(derivative){
+							dw[x] = d_sum;
+						}
+					}
+					break;
+				}
+				case Step_type::Replace:{
+					const double* same = same_m[i].data();
+					const double* diff = diff_m[i].data();
+					const double* exponent = exponent_m[i].data();
+					const double self = step.self;
+					#pragma omp parallel for schedule(static)
+					for(size_t x = 0; x < n_extended_m; x++){
+						const size_t s = digit(x, step.site);
+						size_t mask = 0;
+						for(size_t k = 0; k < step.sources.size(); k++){
+							if(digit(x, step.sources[k]) == s){
+								mask |= size_t(1) << k;
+							}
+						}
+						const size_t base = x - s*stride;
+						double sum = 0, d_sum = 0;
+						for(size_t t = 0; t < q; t++){
+							sum += v[base + t*stride];
+							if(derivative){
+								d_sum += dv[base + t*stride];
+							}
+						}
+						w[x] = diff[mask]*sum + (same[mask] - diff[mask])*v[x];
+						if(derivative){
+							const double a = exponent[mask];
+							dw[x] = diff[mask]*(a*sum + d_sum) + same[mask]*((a + self)*v[x] + dv[x]) - diff[mask]*(a*v[x] + dv[x]);
+						}
+					}
+					break;
+				}
+			}
+		}
+
+		// w = T v on the layer states, and dw = dT/dbeta v if derivative
+		template<bool derivative>
+		void apply_shifted(const double* v, double* w, double* dw)
+		{
+			work_m.resize(n_extended_m);
+			next_m.resize(n_extended_m);
+			if(derivative){
+				d_work_m.resize(n_extended_m);
+				d_next_m.resize(n_extended_m);
+			}
+			#pragma omp parallel for schedule(static)
+			for(size_t x = 0; x < n_extended_m; x++){
+				work_m[x] = x < n_states_m ? diagonal_m[x]*v[x] : 0;
+				if(derivative){
+					d_work_m[x] = x < n_states_m ? -(layer_energy_m[x] - min_layer_energy_m)/2*work_m[x] : 0;
+				}
+			}
+			for(size_t i = 0; i < steps_m.size(); i++){
+				apply_step<derivative>(i, work_m.data(), next_m.data(), d_work_m.data(), d_next_m.data());
+				std::swap(work_m, next_m);
+				if(derivative){
+					std::swap(d_work_m, d_next_m);
+				}
+			}
+			#pragma omp parallel for schedule(static)
+			for(size_t x = 0; x < n_states_m; x++){
+				w[x] = diagonal_m[x]*work_m[x];
+				if(derivative){
+					dw[x] = diagonal_m[x]*(d_work_m[x] - (layer_energy_m[x] - min_layer_energy_m)/2*work_m[x]);
+				}
+			}
+		}
+
+		double dot(const double* a, const double* b) const
+		{
+			double res = 0;
+			#pragma omp parallel for reduction(+:res) schedule(static)
+			for(size_t x = 0; x < n_states_m; x++){
+				res += a[x]*b[x];
+			}
+			return res;
+		}
+
+		void randomise(Lattice_vector<double>& v)
+		{
+			for(size_t x = 0; x < n_states_m; x++){
+				v[x] = static_cast<double>(splitmix64_next(random_state_m) >> 11)/9007199254740992. - 0.5;
+			}
+		}
+
+		// Modified Gram-Schmidt, projecting twice for stability. Vectors
+		// that vanish in the projection, as when T has a null space, are
+		// replaced by random ones
+		void orthonormalise(std::vector<Lattice_vector<double>>& vectors)
+		{
+			for(size_t i = 0; i < vectors.size(); i++){
+				double* vi = vectors[i].data();
+				for(size_t attempt = 0; attempt < 10; attempt++){
+					const double initial = std::sqrt(dot(vi, vi));
+					for(size_t pass = 0; pass < 2; pass++){
+						for(size_t j = 0; j < i; j++){
+							const double* vj = vectors[j].data();
+							const double overlap = dot(vi, vj);
+							#pragma omp parallel for schedule(static)
+							for(size_t x = 0; x < n_states_m; x++){
+								vi[x] -= overlap*vj[x];
+							}
+						}
+					}
+					const double norm = std::sqrt(dot(vi, vi));
+					if(norm > 1e-8*initial && norm > 0){
+						#pragma omp parallel for schedule(static)
+						for(size_t x = 0; x < n_states_m; x++){
+							vi[x] /= norm;
+						}
+						break;
+					}
+					randomise(vectors[i]);
+				}
+			}
+		}
+
+		// Eigenvalues and eigenvectors (columns of Y) of the symmetric n x n
+		// matrix A by cyclic Jacobi rotations, sorted by decreasing |lambda|
+		static std::vector<double> symmetric_eigen(std::vector<double> A, const size_t n, std::vector<double>& Y)
+		{
+			Y.assign(n*n, 0);
+			for(size_t i = 0; i < n; i++){
+				Y[i*n + i] = 1;
+			}
+			for(size_t sweep = 0; sweep < 100; sweep++){
+				double off = 0, total = 0;
+				for(size_t i = 0; i < n; i++){
+					for(size_t j = 0; j < n; j++){
+						total += A[i*n + j]*A[i*n + j];
+						if(i != j){
+							off += A[i*n + j]*A[i*n + j];
+						}
+					}
+				}
+				if(off <= 1e-30*total){
+					break;
+				}
+				for(size_t p = 0; p < n; p++){
+					for(size_t r = p + 1; r < n; r++){
+						if(A[p*n + r] == 0){
+							continue;
+						}
+						const double theta = (A[r*n + r] - A[p*n + p])/(2*A[p*n + r]);
+						const double t = (theta >= 0 ? 1 : -1)/(std::abs(theta) + std::sqrt(theta*theta + 1));
+						const double c = 1/std::sqrt(t*t + 1), s = t*c;
+						for(size_t k = 0; k < n; k++){
+							const double akp = A[k*n + p], akr = A[k*n + r];
+							A[k*n + p] = c*akp - s*akr;
+							A[k*n + r] = s*akp + c*akr;
+						}
+						for(size_t k = 0; k < n; k++){
+							const double apk = A[p*n + k], ark = A[r*n + k];
+							A[p*n + k] = c*apk - s*ark;
+							A[r*n + k] = s*apk + c*ark;
+						}
+						for(size_t k = 0; k < n; k++){
+							const double ykp = Y[k*n + p], ykr = Y[k*n + r];
+							Y[k*n + p] = c*ykp - s*ykr;
+							Y[k*n + r] = s*ykp + c*ykr;
+						}
+					}
+				}
+			}
+			std::vector<size_t> idx(n);
+			for(size_t i = 0; i < n; i++){
+				idx[i] = i;
+			}
+			std::sort(idx.begin(), idx.end(), [&](const size_t a, const size_t b){
+				return std::abs(A[a*n + a]) > std::abs(A[b*n + b]);
+			});
+			std::vector<double> res(n), sorted(n*n);
+			for(size_t i = 0; i < n; i++){
+				res[i] = A[idx[i]*n + idx[i]];
+				for(size_t k = 0; k < n; k++){
+					sorted[k*n + i] = Y[k*n + idx[i]];
+				}
+			}
+			Y = sorted;
+			return res;
+		}
+
+	public:
+		explicit Transfer_matrix_t(const Potts_t<dim, q>& strip)
+		 : n_layer_m(0), n_buffers_m(0), n_states_m(0), n_extended_m(0), stride_m(), steps_m(), layer_energy_m(),
+		 min_layer_energy_m(0), shift_m(0), random_state_m(0x5eed), beta_m(0), same_m(), diff_m(), exponent_m(), diagonal_m(), work_m(), next_m(),
+		 d_work_m(), d_next_m(), vectors_m()
+		{
+			setup(strip);
+		}
+
+		// Sites in a layer, layer states q^W and buffer spins
+		size_t width() const {return n_layer_m;}
+		size_t n_states() const {return n_states_m;}
+		size_t n_buffers() const {return n_buffers_m;}
+		double energy_shift() const {return shift_m;}
+
+		// w = exp(-beta energy_shift()) T v, v and w of length n_states()
+		void apply(const double beta, const std::vector<double>& v, std::vector<double>& w)
+		{
+			if(v.size() != n_states_m){
+				throw std::invalid_argument("Vector does not match the transfer matrix");
+			}
+			set_beta(beta);
+			w.resize(n_states_m);
+			apply_shifted<false>(v.data(), w.data(), nullptr);
+		}
+
+		// Leading eigenvalues at beta, iterating on n_vectors vectors until the
+		// two leading eigenvalues change by less than tolerance relative
+		Transfer_result_t solve(const double beta, const double tolerance = 1e-12, const size_t max_iterations = 100000,
+			const size_t n_vectors = 4)
+		{
+			if(beta <= 0){
+				throw std::invalid_argument("The transfer matrix needs beta > 0");
+			}
+			const size_t k = std::max(std::min(std::min(n_vectors, n_states_m), size_t(64)), size_t(1));
+			set_beta(beta);
+			if(vectors_m.size() != k){
+				vectors_m.assign(k, Lattice_vector<double>(n_states_m));
+				std::fill(vectors_m[0].begin(), vectors_m[0].end(), 1);
+				for(size_t i = 1; i < k; i++){
+					randomise(vectors_m[i]);
+				}
+				orthonormalise(vectors_m);
+			}
+			std::vector<Lattice_vector<double>> images(k, Lattice_vector<double>(n_states_m));
+			std::vector<double> A(k*k), Y, theta, old_theta(k, 0);
+			size_t it = 0;
+			for(; it < max_iterations; it++){
+				for(size_t i = 0; i < k; i++){
+					apply_shifted<false>(vectors_m[i].data(), images[i].data(), nullptr);
+				}
+				for(size_t i = 0; i < k; i++){
+					for(size_t j = i; j < k; j++){
+						A[i*k + j] = A[j*k + i] = (dot(vectors_m[i].data(), images[j].data()) + dot(vectors_m[j].data(), images[i].data()))/2;
+					}
+				}
+				theta = symmetric_eigen(A, k, Y);
+				// Ritz vectors of T V, the next subspace
+				#pragma omp parallel for schedule(static)
+				for(size_t x = 0; x < n_states_m; x++){
+					double row[64];
+					for(size_t i = 0; i < k; i++){
+						row[i] = 0;
+						for(size_t j = 0; j < k; j++){
+							row[i] += images[j][x]*Y[j*k + i];
+						}
+					}
+					for(size_t i = 0; i < k; i++){
+						vectors_m[i][x] = row[i];
+					}
+				}
+				orthonormalise(vectors_m);
+				bool converged = it > 0;
+				for(size_t i = 0; i < std::min(k, size_t(2)); i++){
+					converged = converged && std::abs(theta[i] - old_theta[i]) <= tolerance*std::abs(theta[i]);
+				}
+				old_theta = theta;
+				if(converged){
+					it++;
+					break;
+				}
+			}
+
+			// psi is normalised, so dln(lambda)/dbeta = <psi|dT/dbeta|psi>/lambda
+			Lattice_vector<double>& psi = vectors_m[0];
+			Lattice_vector<double>& t_psi = images[0];
+			Lattice_vector<double> dt_psi(n_states_m);
+			apply_shifted<true>(psi.data(), t_psi.data(), dt_psi.data());
+			const double lambda = dot(psi.data(), t_psi.data());
+			const double d_log_lambda = dot(psi.data(), dt_psi.data())/lambda + shift_m;
+
+			const double n = static_cast<double>(n_layer_m);
+			Transfer_result_t res;
+			res.beta = beta;
+			res.log_lambda = std::log(lambda) + beta*shift_m;
+			res.free_energy = -res.log_lambda/(beta*n);
+			res.energy = -d_log_lambda/n;
+			res.correlation_length = k > 1 && theta[1] != 0 ? 1/std::log(std::abs(theta[0]/theta[1])) : 0;
+			res.iterations = it;
+			return res;
+		}
+
+		// Solve for each beta in turn, each starting from the eigenvectors of
+		// the previous one
+		std::vector<Transfer_result_t> scan(const std::vector<double>& betas, const double tolerance = 1e-12,
+			const size_t max_iterations = 100000, const size_t n_vectors = 4)
+		{
+			std::vector<Transfer_result_t> res;
+			res.reserve(betas.size());
+			for(const double beta : betas){
+				res.push_back(solve(beta, tolerance, max_iterations, n_vectors));
+			}
+			return res;
+		}
+};
+
+#endif // TRANSFER_MATRIX_H